@@ -3,428 +3,3425 @@
 #include <fstream>
 #include <iomanip>
 #include <memory>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <cctype>
+#include <cstdlib>
+#include <cstdio>
+#include <string_view>
+#include <chrono>
+#include <new>
+#include <algorithm>
+#include <cassert>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <functional>
+#include <variant>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#endif
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
 
 using namespace std;
 
-// Custom exceptions
+// Error codes carried by every ECommerceException
+enum class ErrorCode : uint8_t {
+    General,
+    ProductNotFound,
+    InvalidInput,
+    OutOfStock,
+    ArrayFull,       // a store or ID range has no room left
+    IoFailure,
+    PaymentDeclined, // the payment method refused the amount
+    PaymentFailed,   // the payment method raised an error
+    OrderFailed      // paid, but the order could not be stored; the cart is left unchanged
+};
+
+// Custom exceptions. The code and its arguments live in fixed-size storage, so
+// throwing never allocates a string; what() formats the message on first use.
+// An error may carry the code and message of the error that caused it.
 class ECommerceException : public exception {
+public:
+    static constexpr size_t DETAIL_CAPACITY = 96;
+    static constexpr size_t CAUSE_CAPACITY = 128;
+    static constexpr size_t MESSAGE_CAPACITY = 256;
+
 private:
-    string message;
+    ErrorCode code;
+    ErrorCode causeCode;
+    int32_t value;
+    uint8_t detailLength;
+    uint8_t causeLength;
+    char detail[DETAIL_CAPACITY];           // ID or message text, truncated to fit
+    char cause[CAUSE_CAPACITY];             // what() of the cause, truncated to fit
+    mutable char message[MESSAGE_CAPACITY]; // empty until what() formats it
+
 public:
-    ECommerceException(const string& msg) : message(msg) {}
+    ECommerceException(ErrorCode _code, string_view _detail, int32_t _value = 0)
+        : code(_code), causeCode(ErrorCode::General), value(_value),
+          detailLength(static_cast<uint8_t>(min(_detail.size(), DETAIL_CAPACITY - 1))), causeLength(0) {
+        memcpy(detail, _detail.data(), detailLength);
+        detail[detailLength] = '\0';
+        cause[0] = '\0';
+        message[0] = '\0';
+    }
+
+    ECommerceException(string_view msg) : ECommerceException(ErrorCode::General, msg) {}
+
+    // Keep the code and message of the error that led to this one
+    ECommerceException& causedBy(const exception& error) noexcept {
+        const ECommerceException* known = dynamic_cast<const ECommerceException*>(&error);
+        causeCode = known ? known->code
+                  : dynamic_cast<const ios_base::failure*>(&error) ? ErrorCode::IoFailure
+                  : ErrorCode::General;
+        const char* text = error.what();
+        causeLength = static_cast<uint8_t>(strnlen(text, CAUSE_CAPACITY - 1));
+        memcpy(cause, text, causeLength);
+        cause[causeLength] = '\0';
+        message[0] = '\0';
+        return *this;
+    }
+
+    // Getters
+    ErrorCode getCode() const noexcept { return code; }
+    string_view getDetail() const noexcept { return string_view(detail, detailLength); }
+    bool hasCause() const noexcept { return causeLength > 0; }
+    ErrorCode getCauseCode() const noexcept { return causeCode; }
+    string_view getCause() const noexcept { return string_view(cause, causeLength); }
+
+    // Throw this error, cause included, as the exception class its code belongs to
+    [[noreturn]] void raise() const;
+
     virtual const char* what() const noexcept override {
-        return message.c_str();
+        if (message[0] == '\0') {
+            int length = static_cast<int>(detailLength);
+            switch (code) {
+                case ErrorCode::ProductNotFound:
+                    snprintf(message, sizeof(message), "Product with ID '%.*s' not found!", length, detail);
+                    break;
+                case ErrorCode::InvalidInput:
+                    snprintf(message, sizeof(message), "Invalid input: %.*s", length, detail);
+                    break;
+                case ErrorCode::OutOfStock:
+                    snprintf(message, sizeof(message), "Not enough stock for product '%.*s' (%d available).",
+                             length, detail, static_cast<int>(value));
+                    break;
+                case ErrorCode::ArrayFull:
+                    snprintf(message, sizeof(message), "%.*s is full. Cannot add more items.", length, detail);
+                    break;
+                case ErrorCode::PaymentDeclined:
+                    snprintf(message, sizeof(message), "Payment was declined with method: %.*s", length, detail);
+                    break;
+                case ErrorCode::PaymentFailed:
+                    snprintf(message, sizeof(message), "Payment failed with method: %.*s", length, detail);
+                    break;
+                case ErrorCode::OrderFailed:
+                    snprintf(message, sizeof(message), "Order could not be stored after payment with method: %.*s",
+                             length, detail);
+                    break;
+                default:
+                    snprintf(message, sizeof(message), "%.*s", length, detail);
+                    break;
+            }
+            if (causeLength > 0) {
+                size_t used = strlen(message);
+                snprintf(message + used, sizeof(message) - used, " (%s)", cause);
+            }
+        }
+        return message;
+    }
+
+private:
+    template <typename E>
+    [[noreturn]] void raiseAs(E error) const {
+        static_cast<ECommerceException&>(error) = *this;
+        throw error;
     }
 };
 
 class ProductNotFoundException : public ECommerceException {
 public:
-    ProductNotFoundException(const string& id) 
-        : ECommerceException("Product with ID '" + id + "' not found!") {}
+    ProductNotFoundException(string_view id) 
+        : ECommerceException(ErrorCode::ProductNotFound, id) {}
 };
 
 class InvalidInputException : public ECommerceException {
 public:
-    InvalidInputException(const string& msg) 
-        : ECommerceException("Invalid input: " + msg) {}
+    InvalidInputException(string_view msg) 
+        : ECommerceException(ErrorCode::InvalidInput, msg) {}
+};
+
+class OutOfStockException : public ECommerceException {
+public:
+    OutOfStockException(string_view id, int available) 
+        : ECommerceException(ErrorCode::OutOfStock, id, available) {}
 };
 
 class ArrayFullException : public ECommerceException {
 public:
-    ArrayFullException(const string& arrayName) 
-        : ECommerceException(arrayName + " is full. Cannot add more items.") {}
+    ArrayFullException(string_view arrayName) 
+        : ECommerceException(ErrorCode::ArrayFull, arrayName) {}
+};
+
+inline void ECommerceException::raise() const {
+    switch (code) {
+        case ErrorCode::ProductNotFound: raiseAs(ProductNotFoundException(getDetail()));
+        case ErrorCode::InvalidInput: raiseAs(InvalidInputException(getDetail()));
+        case ErrorCode::OutOfStock: raiseAs(OutOfStockException(getDetail(), value));
+        case ErrorCode::ArrayFull: raiseAs(ArrayFullException(getDetail()));
+        default: throw *this;
+    }
+}
+
+// Outcome of a non-throwing call: a value, or the error the throwing version would raise
+template <typename T>
+class Result {
+private:
+    variant<T, ECommerceException> outcome;
+
+public:
+    // Constructors
+    Result(T value) : outcome(in_place_index<0>, move(value)) {}
+    Result(const ECommerceException& error) : outcome(in_place_index<1>, error) {}
+
+    bool ok() const { return outcome.index() == 0; }
+    explicit operator bool() const { return ok(); }
+
+    // Getters; value() requires ok(), error() requires !ok()
+    T& value() { return *get_if<0>(&outcome); }
+    const T& value() const { return *get_if<0>(&outcome); }
+    const ECommerceException& error() const { return *get_if<1>(&outcome); }
+};
+
+// Result of a call that produces no value
+template <>
+class Result<void> {
+private:
+    variant<monostate, ECommerceException> outcome;
+
+public:
+    // Constructors
+    Result() {}
+    Result(const ECommerceException& error) : outcome(in_place_index<1>, error) {}
+
+    bool ok() const { return outcome.index() == 0; }
+    explicit operator bool() const { return ok(); }
+    const ECommerceException& error() const { return *get_if<1>(&outcome); }
+};
+
+// Error handling for code shared by a try* function and its throwing version:
+// ReturnError hands the error back to become a Result, while ThrowError throws
+// the concrete exception straight away without building a Result around it
+struct ReturnError {
+    template <typename E>
+    const E& operator()(const E& error) const { return error; }
+};
+
+struct ThrowError {
+    template <typename E>
+    [[noreturn]] const E& operator()(const E& error) const { throw error; }
+};
+
+// Money class: an exact amount in centavos
+class Money {
+private:
+    int64_t centavos;
+
+    constexpr explicit Money(int64_t _centavos) : centavos(_centavos) {}
+
+public:
+    // Constructor
+    constexpr Money() : centavos(0) {}
+
+    static constexpr Money fromCentavos(int64_t amount) { return Money(amount); }
+
+    // Parse "123", "123.5" or "123.45" exactly; false on anything else
+    static bool parse(const char* begin, const char* end, Money& amount) {
+        int64_t whole = 0;
+        const char* p = begin;
+        for (; p < end && *p >= '0' && *p <= '9'; p++) {
+            if (whole > (INT64_MAX - 9) / 1000) {
+                return false;
+            }
+            whole = whole * 10 + (*p - '0');
+        }
+        if (p == begin) {
+            return false;
+        }
+        int64_t fraction = 0;
+        if (p < end && *p == '.') {
+            p++;
+            int digits = 0;
+            for (; p < end && *p >= '0' && *p <= '9' && digits < 2; p++, digits++) {
+                fraction = fraction * 10 + (*p - '0');
+            }
+            if (digits == 1) {
+                fraction *= 10;
+            }
+        }
+        if (p != end) {
+            return false;
+        }
+        amount = Money(whole * 100 + fraction);
+        return true;
+    }
+
+    // Getters
+    constexpr int64_t getCentavos() const { return centavos; }
+
+    // Arithmetic
+    constexpr Money operator+(Money other) const { return Money(centavos + other.centavos); }
+    constexpr Money operator-(Money other) const { return Money(centavos - other.centavos); }
+    constexpr Money operator*(int64_t quantity) const { return Money(centavos * quantity); }
+    Money& operator+=(Money other) { centavos += other.centavos; return *this; }
+    Money& operator-=(Money other) { centavos -= other.centavos; return *this; }
+
+    // Comparisons
+    constexpr bool operator==(Money other) const { return centavos == other.centavos; }
+    constexpr bool operator!=(Money other) const { return centavos != other.centavos; }
+    constexpr bool operator<(Money other) const { return centavos < other.centavos; }
+    constexpr bool operator<=(Money other) const { return centavos <= other.centavos; }
+    constexpr bool operator>(Money other) const { return centavos > other.centavos; }
+    constexpr bool operator>=(Money other) const { return centavos >= other.centavos; }
+
+    // Display as pesos with two decimals; honours setw on the stream
+    friend ostream& operator<<(ostream& out, Money amount) {
+        char buffer[32];
+        uint64_t magnitude = amount.centavos < 0 ? 0 - static_cast<uint64_t>(amount.centavos)
+                                                 : static_cast<uint64_t>(amount.centavos);
+        snprintf(buffer, sizeof(buffer), "%s%llu.%02llu", amount.centavos < 0 ? "-" : "",
+                 static_cast<unsigned long long>(magnitude / 100),
+                 static_cast<unsigned long long>(magnitude % 100));
+        return out << buffer;
+    }
+};
+
+namespace std {
+template <>
+struct hash<Money> {
+    size_t operator()(Money amount) const noexcept {
+        return hash<int64_t>()(amount.getCentavos());
+    }
+};
+}
+
+// Fixed-width, uppercase product ID used as the catalog hash key
+struct ProductKey {
+    static constexpr size_t WIDTH = 16;
+    char chars[WIDTH];
+
+    ProductKey() { memset(chars, 0, WIDTH); }
+
+    // Normalize an ID into a key without allocating; false if the ID cannot exist
+    static bool normalize(const char* id, size_t length, ProductKey& key) {
+        if (length == 0 || length > WIDTH) {
+            return false;
+        }
+        memset(key.chars, 0, WIDTH);
+        for (size_t i = 0; i < length; i++) {
+            key.chars[i] = static_cast<char>(toupper(static_cast<unsigned char>(id[i])));
+        }
+        return true;
+    }
+
+    bool operator==(const ProductKey& other) const {
+        return memcmp(chars, other.chars, WIDTH) == 0;
+    }
+
+    uint64_t hash() const {
+        uint64_t low, high;
+        memcpy(&low, chars, 8);
+        memcpy(&high, chars + 8, 8);
+        uint64_t h = low * 0x9E3779B97F4A7C15ULL ^ (high + 0xC2B2AE3D27D4EB4FULL);
+        h ^= h >> 29;
+        h *= 0xBF58476D1CE4E5B9ULL;
+        return h ^ (h >> 32);
+    }
+};
+
+// Binary catalog layout (little-endian, memory-mappable, one column per field):
+//   CatalogHeader | ProductKey ids[n] | int64_t prices[n] (centavos) | uint32_t nameOffsets[n + 1] |
+//   int32_t stock[n] (initial stock, or UNLIMITED_STOCK) | name bytes
+struct CatalogHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t productCount;
+    uint64_t namesSize;
+};
+
+static_assert(sizeof(CatalogHeader) == 24, "CatalogHeader layout is part of the file format");
+static_assert(sizeof(ProductKey) == ProductKey::WIDTH, "ProductKey is stored as raw bytes");
+
+// Initial stock value meaning the product is never reserved or counted
+const int32_t UNLIMITED_STOCK = INT32_MAX;
+
+// Live stock level of one product. Carts move units from available to reserved
+// with compare-and-swap; a paid order drops them from reserved.
+struct StockCounter {
+    atomic<int32_t> available;
+    atomic<int32_t> reserved;
+};
+
+// Contiguous product columns, pointing into a mapping or owned storage
+struct ProductColumns {
+    const ProductKey* ids;
+    const int64_t* prices;
+    const uint32_t* nameOffsets; // count + 1 entries; name i is [nameOffsets[i], nameOffsets[i + 1])
+    const int32_t* stock;        // initial stock, or UNLIMITED_STOCK
+    const char* names;
+    StockCounter* const* counters; // live stock, in this catalog's counters or carried over from an older one
+    size_t count;
 };
 
-// Product class
+// Product class: a view of one row of the catalog columns
 class Product {
 private:
-    string id;
-    string name;
-    double price;
+    const ProductColumns* columns;
+    uint32_t position;
     
 public:    
     // Constructor
-    Product(const string& _id, const string& _name, double _price) 
-    : id(_id), name(_name), price(_price) {}
+    Product(const ProductColumns* _columns, uint32_t _position) 
+    : columns(_columns), position(_position) {}
     
     // Getters
-    string getId() const { return id; }
-    string getName() const { return name; }
-    double getPrice() const { return price; }
+    const ProductKey& getKey() const { return columns->ids[position]; }
+    string_view getId() const {
+        const char* id = columns->ids[position].chars;
+        return string_view(id, strnlen(id, ProductKey::WIDTH));
+    }
+    string_view getName() const {
+        uint32_t begin = columns->nameOffsets[position];
+        return string_view(columns->names + begin, columns->nameOffsets[position + 1] - begin);
+    }
+    Money getPrice() const { return Money::fromCentavos(columns->prices[position]); }
+    bool hasUnlimitedStock() const { return columns->stock[position] == UNLIMITED_STOCK; }
+    int32_t getAvailableStock() const {
+        // Below zero only while a reload has cut stock under what carts still hold
+        return hasUnlimitedStock() ? UNLIMITED_STOCK
+                                   : max(0, columns->counters[position]->available.load(memory_order_relaxed));
+    }
+    int32_t getReservedStock() const {
+        return hasUnlimitedStock() ? 0 : columns->counters[position]->reserved.load(memory_order_relaxed);
+    }
+
+    // Take units out of available stock; false (and nothing reserved) if too few are left
+    bool reserveStock(int32_t quantity) const {
+        if (hasUnlimitedStock()) {
+            return true;
+        }
+        StockCounter& counter = *columns->counters[position];
+        int32_t available = counter.available.load(memory_order_relaxed);
+        do {
+            if (available < quantity) {
+                return false;
+            }
+        } while (!counter.available.compare_exchange_weak(available, available - quantity,
+                                                          memory_order_acq_rel, memory_order_relaxed));
+        counter.reserved.fetch_add(quantity, memory_order_relaxed);
+        return true;
+    }
+
+    // Return reserved units to available stock
+    void releaseStock(int32_t quantity) const {
+        if (hasUnlimitedStock()) {
+            return;
+        }
+        StockCounter& counter = *columns->counters[position];
+        counter.reserved.fetch_sub(quantity, memory_order_relaxed);
+        counter.available.fetch_add(quantity, memory_order_release);
+    }
+
+    // Turn reserved units into sold ones
+    void commitStock(int32_t quantity) const {
+        if (!hasUnlimitedStock()) {
+            columns->counters[position]->reserved.fetch_sub(quantity, memory_order_relaxed);
+        }
+    }
     
     // Display product info
     void display() const {
-        cout << left << setw(15) << id
-             << setw(20) << name
-             << setw(10) << fixed << setprecision(2) << price << endl;
+        cout << left << setw(15) << getId()
+             << setw(20) << getName()
+             << setw(10) << getPrice();
+        if (hasUnlimitedStock()) {
+            cout << "-" << endl;
+        } else {
+            cout << getAvailableStock() << endl;
+        }
     }
 };
 
-// Cart Item class
+// Vectorized line-total kernels: sum of prices[i] * quantities[i] in centavos.
+// Vector paths multiply the low 32 bits of each lane, so callers keep unit
+// prices within [0, MAX_UNIT_CENTAVOS] and quantities non-negative.
+const int64_t MAX_UNIT_CENTAVOS = INT32_MAX;
+
+int64_t sumLineTotalsScalar(const int64_t* prices, const int32_t* quantities, size_t count) {
+    int64_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        total += prices[i] * quantities[i];
+    }
+    return total;
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+__attribute__((target("sse2")))
+int64_t sumLineTotalsSSE2(const int64_t* prices, const int32_t* quantities, size_t count) {
+    __m128i sum0 = _mm_setzero_si128();
+    __m128i sum1 = _mm_setzero_si128();
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i q = _mm_loadu_si128(reinterpret_cast<const __m128i*>(quantities + i));
+        __m128i q0 = _mm_unpacklo_epi32(q, zero);
+        __m128i q1 = _mm_unpackhi_epi32(q, zero);
+        __m128i p0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prices + i));
+        __m128i p1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prices + i + 2));
+        sum0 = _mm_add_epi64(sum0, _mm_mul_epu32(p0, q0));
+        sum1 = _mm_add_epi64(sum1, _mm_mul_epu32(p1, q1));
+    }
+    int64_t lanes[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), _mm_add_epi64(sum0, sum1));
+    return lanes[0] + lanes[1] + sumLineTotalsScalar(prices + i, quantities + i, count - i);
+}
+
+__attribute__((target("avx2")))
+int64_t sumLineTotalsAVX2(const int64_t* prices, const int32_t* quantities, size_t count) {
+    __m256i sum0 = _mm256_setzero_si256();
+    __m256i sum1 = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i q0 = _mm256_cvtepi32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(quantities + i)));
+        __m256i q1 = _mm256_cvtepi32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(quantities + i + 4)));
+        __m256i p0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prices + i));
+        __m256i p1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prices + i + 4));
+        sum0 = _mm256_add_epi64(sum0, _mm256_mul_epi32(p0, q0));
+        sum1 = _mm256_add_epi64(sum1, _mm256_mul_epi32(p1, q1));
+    }
+    int64_t lanes[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), _mm256_add_epi64(sum0, sum1));
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + sumLineTotalsScalar(prices + i, quantities + i, count - i);
+}
+#endif
+
+// Pick the widest kernel the CPU supports, once
+int64_t sumLineTotals(const int64_t* prices, const int32_t* quantities, size_t count) {
+    typedef int64_t (*Kernel)(const int64_t*, const int32_t*, size_t);
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    static const Kernel kernel = __builtin_cpu_supports("avx2") ? sumLineTotalsAVX2
+                               : __builtin_cpu_supports("sse2") ? sumLineTotalsSSE2
+                               : sumLineTotalsScalar;
+#else
+    static const Kernel kernel = sumLineTotalsScalar;
+#endif
+    return kernel(prices, quantities, count);
+}
+
+// Cart Item class: a view of one line of a cart or order
 class CartItem {
 private:
-    shared_ptr<Product> product;
+    const Product* product;
+    Money unitPrice;
     int quantity;
-    bool initialized;
     
 public:
-    // Default constructor
-    CartItem() : product(nullptr), quantity(0), initialized(false) {}
-    
     // Constructor
-    CartItem(shared_ptr<Product> _product, int _quantity) 
-        : product(_product), quantity(_quantity), initialized(true) {}
+    CartItem(const Product* _product, Money _unitPrice, int _quantity) 
+        : product(_product), unitPrice(_unitPrice), quantity(_quantity) {}
     
     // Getters
-    shared_ptr<Product> getProduct() const { return product; }
+    const Product* getProduct() const { return product; }
     int getQuantity() const { return quantity; }
-    double getTotalPrice() const { return product ? product->getPrice() * quantity : 0.0; }
-    bool isInitialized() const { return initialized; }
+    Money getUnitPrice() const { return unitPrice; }
+    Money getTotalPrice() const { return unitPrice * quantity; }
     
     // Display cart item info
     void display() const {
-        if (initialized && product) {
+        if (product) {
             cout << left 
                  << setw(15) << product->getId()
                  << setw(20) << product->getName()
-                 << setw(10) << fixed << setprecision(2) << product->getPrice()
+                 << setw(10) << unitPrice
                  << setw(10) << quantity << endl;
         }
     }
 };
 
-// Order class
-class Order {
+// Vector that keeps its first N elements inline and spills to the heap past that
+template <typename T, size_t N>
+class SmallVector {
 private:
-    int orderId;
-    CartItem items[10];
-    int itemCount;
-    string paymentMethod;
-    double totalAmount;
-    bool initialized;
-    
-public:
-    // Default constructor
-    Order() : orderId(0), itemCount(0), paymentMethod(""), totalAmount(0.0), initialized(false) {}
-    
-    // Constructor
-    Order(int _orderId, const CartItem* _items, int _itemCount, const string& _paymentMethod)
-        : orderId(_orderId), itemCount(_itemCount), paymentMethod(_paymentMethod), 
-          totalAmount(0.0), initialized(true) {
-        
-        // Copy items
-        for (int i = 0; i < _itemCount && i < 10; i++) {
-            items[i] = _items[i];
+    alignas(T) unsigned char inlineBuffer[N * sizeof(T)];
+    T* elements;
+    size_t count;
+    size_t capacity;
+
+    T* inlineElements() { return reinterpret_cast<T*>(inlineBuffer); }
+    const T* inlineElements() const { return reinterpret_cast<const T*>(inlineBuffer); }
+
+    void release() {
+        clear();
+        if (elements != inlineElements()) {
+            ::operator delete(elements);
         }
-        
-        calculateTotal();
+        elements = inlineElements();
+        capacity = N;
     }
-    
-    // Calculate total amount
-    void calculateTotal() {
-        totalAmount = 0;
-        for (int i = 0; i < itemCount; i++) {
-            if (items[i].isInitialized()) {
-                totalAmount += items[i].getTotalPrice();
+
+    // Take other's contents; heap storage is stolen, inline elements are moved one by one
+    void steal(SmallVector& other) {
+        if (other.elements != other.inlineElements()) {
+            elements = other.elements;
+            count = other.count;
+            capacity = other.capacity;
+            other.elements = other.inlineElements();
+            other.count = 0;
+            other.capacity = N;
+        } else {
+            for (size_t i = 0; i < other.count; i++) {
+                new (&elements[i]) T(move(other.elements[i]));
             }
+            count = other.count;
+            other.clear();
         }
     }
-    
-    // Getters
-    int getOrderId() const { return orderId; }
-    const CartItem* getItems() const { return items; }
-    int getItemCount() const { return itemCount; }
-    string getPaymentMethod() const { return paymentMethod; }
-    double getTotalAmount() const { return totalAmount; }
-    bool isInitialized() const { return initialized; }
-    
-    // Display order details
-    void display() const {
-        if (!initialized) return;
-        
-        cout << "\nOrder ID: " << orderId << endl;
-        cout << "Total Amount: " << fixed << setprecision(2) << totalAmount << endl;
-        cout << "Payment Method: " << paymentMethod << endl;
-        cout << "Order Details:" << endl;
-        cout << left << setw(15) << "Product ID" 
-             << setw(20) << "Name" 
-             << setw(10) << "Price" 
-             << setw(10) << "Quantity" << endl;
-        
-        for (int i = 0; i < itemCount; i++) {
-            items[i].display();
-        }
-        cout << endl;
-    }
-};
 
-// Shopping Cart class
-class ShoppingCart {
-private:
-    CartItem items[10];
-    int itemCount;
-    
 public:
     // Constructor
-    ShoppingCart() : itemCount(0) {}
-    
-    // Add item to cart
-    void addItem(shared_ptr<Product> product, int quantity) {
-        if (itemCount >= 10) {
-            throw ArrayFullException("Shopping Cart");
-        }
-        
-        items[itemCount++] = CartItem(product, quantity);
-    }
-    
-    // Clear cart
-    void clear() {
-        for (int i = 0; i < itemCount; i++) {
-            items[i] = CartItem(); // Reset to default
+    SmallVector() : elements(inlineElements()), count(0), capacity(N) {}
+
+    SmallVector(const SmallVector& other) : SmallVector() {
+        reserve(other.count);
+        for (size_t i = 0; i < other.count; i++) {
+            new (&elements[i]) T(other.elements[i]);
         }
-        itemCount = 0;
+        count = other.count;
     }
-    
-    // Get items in cart
-    const CartItem* getItems() const {
-        return items;
+
+    SmallVector(SmallVector&& other) noexcept : SmallVector() {
+        steal(other);
     }
-    
-    // Get item count
-    int getItemCount() const {
-        return itemCount;
+
+    SmallVector& operator=(const SmallVector& other) {
+        if (this != &other) {
+            SmallVector copy(other);
+            release();
+            steal(copy);
+        }
+        return *this;
     }
-    
-    // Calculate total amount
-    double getTotalAmount() const {
-        double total = 0;
-        for (int i = 0; i < itemCount; i++) {
-            total += items[i].getTotalPrice();
+
+    SmallVector& operator=(SmallVector&& other) noexcept {
+        if (this != &other) {
+            release();
+            steal(other);
         }
-        return total;
+        return *this;
     }
-    
-    // Check if cart is empty
-    bool isEmpty() const {
-        return itemCount == 0;
+
+    // Destructor
+    ~SmallVector() {
+        release();
     }
-    
-    // Display cart contents
-    void display() const {
-        if (isEmpty()) {
-            cout << "Your shopping cart is empty." << endl;
+
+    // Grow capacity to at least the given size, moving elements to the heap
+    void reserve(size_t wanted) {
+        if (wanted <= capacity) {
             return;
         }
-        
-        cout << "\n----- Shopping Cart -----" << endl;
-        cout << left << setw(15) << "Product ID" 
-             << setw(20) << "Name" 
-             << setw(10) << "Price" 
-             << setw(10) << "Quantity" << endl;
-        
-        for (int i = 0; i < itemCount; i++) {
-            items[i].display();
+        size_t newCapacity = max(wanted, capacity * 2);
+        T* grown = static_cast<T*>(::operator new(newCapacity * sizeof(T)));
+        for (size_t i = 0; i < count; i++) {
+            new (&grown[i]) T(move(elements[i]));
+            elements[i].~T();
         }
-        
-        cout << "\nTotal Amount: ₱" << fixed << setprecision(2) << getTotalAmount() << endl;
+        if (elements != inlineElements()) {
+            ::operator delete(elements);
+        }
+        elements = grown;
+        capacity = newCapacity;
     }
-};
 
-// Inventory class for product management
-class Inventory {
-private:
-    shared_ptr<Product> products[5]; 
-    int productCount;
-    
-public:
-    // Constructor with initial products
-    Inventory() : productCount(5) {
-        products[0] = make_shared<Product>("A1B2C3", "C2 Green Tea", 32.0);
-        products[1] = make_shared<Product>("X9Y8Z7", "Zesto Juice Drink", 14.0);
-        products[2] = make_shared<Product>("P4Q5R6", "Cobra Energy Drink", 29.0);
-        products[3] = make_shared<Product>("M7N8O9", "1.5L Royal", 75.0);
-        products[4] = make_shared<Product>("J1K2L3", "Milo", 12.5);
+    void push_back(const T& value) {
+        if (count == capacity) {
+            T copy(value);
+            reserve(count + 1);
+            new (&elements[count]) T(move(copy));
+        } else {
+            new (&elements[count]) T(value);
+        }
+        count++;
     }
 
-    shared_ptr<Product> findProduct(const string& id) const {
-        // Manually convert input ID to uppercase
-        string upperId = id;
-        for (size_t i = 0; i < upperId.length(); i++) {
-            upperId[i] = toupper(upperId[i]);
+    void push_back(T&& value) {
+        reserve(count + 1);
+        new (&elements[count]) T(move(value));
+        count++;
+    }
+
+    void pop_back() {
+        elements[--count].~T();
+    }
+
+    // Remove the element at a position, shifting later elements down
+    void erase(size_t position) {
+        for (size_t i = position + 1; i < count; i++) {
+            elements[i - 1] = move(elements[i]);
         }
-    
-        // Compare with stored uppercase IDs
-        for (int i = 0; i < productCount; i++) {
-            if (products[i]->getId() == upperId) {
-                return products[i];
-            }
+        pop_back();
+    }
+
+    // Replace the contents with n copies of a value
+    void assign(size_t n, const T& value) {
+        clear();
+        reserve(n);
+        for (size_t i = 0; i < n; i++) {
+            new (&elements[i]) T(value);
         }
-        throw ProductNotFoundException(id);
+        count = n;
     }
-    
-    // Display all products
-    void displayProducts() const {
-        cout << "\n----- Available Products -----" << endl;
-        cout << left << setw(15) << "Product ID" 
-             << setw(20) << "Name" 
-             << setw(10) << "Price" << endl;
-        
-        for (int i = 0; i < productCount; i++) {
-            products[i]->display();
+
+    // Destroy all elements; heap storage is kept for reuse
+    void clear() {
+        for (size_t i = 0; i < count; i++) {
+            elements[i].~T();
         }
+        count = 0;
     }
+
+    // Getters
+    T& operator[](size_t i) { return elements[i]; }
+    const T& operator[](size_t i) const { return elements[i]; }
+    T* data() { return elements; }
+    const T* data() const { return elements; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    bool isInline() const { return elements == inlineElements(); }
 };
 
-// Strategy Pattern for Payment Methods
-class PaymentStrategy {
+// Line items stored column-wise so totals run over contiguous prices and quantities.
+// The first INLINE_LINES lines need no allocation; larger carts spill to the heap.
+class LineItems {
 public:
-    virtual ~PaymentStrategy() = default;
-    virtual bool processPayment(double amount) = 0;
-    virtual string getMethodName() const = 0;
-};
+    static const size_t INLINE_LINES = 10;
+
+private:
+    SmallVector<shared_ptr<Product>, INLINE_LINES> products;
+    SmallVector<int64_t, INLINE_LINES> unitPrices; // centavos
+    SmallVector<int32_t, INLINE_LINES> quantities;
+
+    friend class OrderLines;
 
-class CashPayment : public PaymentStrategy {
 public:
-    bool processPayment(double amount) override {
-        cout << "Processing cash payment of ₱" << fixed << setprecision(2) << amount << endl;
-        return true;
+    // Append a line at the product's current price
+    void add(shared_ptr<Product> product, int quantity) {
+        Money unitPrice = product->getPrice();
+        add(move(product), unitPrice, quantity);
     }
-    
-    string getMethodName() const override {
-        return "Cash";
+
+    // Append a line at a given unit price
+    void add(shared_ptr<Product> product, Money unitPrice, int quantity) {
+        unitPrices.push_back(unitPrice.getCentavos());
+        quantities.push_back(quantity);
+        products.push_back(move(product));
     }
-};
 
-class CardPayment : public PaymentStrategy {
-public:
-    bool processPayment(double amount) override {
-        cout << "Processing credit/debit card payment of ₱" << fixed << setprecision(2) << amount << endl;
-        return true;
+    // Remove all lines
+    void clear() {
+        products.clear();
+        unitPrices.clear();
+        quantities.clear();
+    }
+
+    // Add to the quantity of an existing line
+    void addQuantity(int line, int quantity) {
+        quantities[line] += quantity;
+    }
+
+    // Replace the quantity of an existing line
+    void setQuantity(int line, int quantity) {
+        quantities[line] = quantity;
+    }
+
+    // Remove a line, keeping the order of the others
+    void remove(int line) {
+        products.erase(line);
+        unitPrices.erase(line);
+        quantities.erase(line);
+    }
+
+    // Line at a position
+    CartItem operator[](int i) const {
+        return CartItem(products[i].get(), Money::fromCentavos(unitPrices[i]), quantities[i]);
+    }
+
+    // Product of a line
+    const Product* productAt(int i) const {
+        return products[i].get();
+    }
+
+    // Getters
+    int size() const { return static_cast<int>(products.size()); }
+    bool empty() const { return products.empty(); }
+
+    // Sum of all line totals
+    Money total() const {
+        return Money::fromCentavos(sumLineTotals(unitPrices.data(), quantities.data(), quantities.size()));
+    }
+};
+
+// Lines of a stored order: the same columns as LineItems in one exactly sized
+// block, so a stored order does not carry a cart's inline buffers
+class OrderLines {
+private:
+    void* block; // products[count] | unitPrices[count] (centavos) | quantities[count]
+    uint32_t count;
+
+    shared_ptr<Product>* products() const { return static_cast<shared_ptr<Product>*>(block); }
+    int64_t* unitPrices() const { return reinterpret_cast<int64_t*>(products() + count); }
+    int32_t* quantities() const { return reinterpret_cast<int32_t*>(unitPrices() + count); }
+
+    void release() {
+        for (uint32_t i = 0; i < count; i++) {
+            products()[i].~shared_ptr<Product>();
+        }
+        ::operator delete(block);
+        block = nullptr;
+        count = 0;
+    }
+
+public:
+    // Constructor
+    OrderLines() : block(nullptr), count(0) {}
+
+    // Take over a cart's lines. The block is allocated before anything moves, so if
+    // that throws the lines are still in items.
+    explicit OrderLines(LineItems&& items) : block(nullptr), count(0) {
+        uint32_t size = static_cast<uint32_t>(items.size());
+        if (size == 0) {
+            return;
+        }
+        block = ::operator new(size * (sizeof(shared_ptr<Product>) + sizeof(int64_t) + sizeof(int32_t)));
+        count = size;
+        for (uint32_t i = 0; i < count; i++) {
+            new (&products()[i]) shared_ptr<Product>(move(items.products[i]));
+        }
+        memcpy(unitPrices(), items.unitPrices.data(), count * sizeof(int64_t));
+        memcpy(quantities(), items.quantities.data(), count * sizeof(int32_t));
+        items.clear();
+    }
+
+    OrderLines(const OrderLines&) = delete;
+    OrderLines& operator=(const OrderLines&) = delete;
+
+    OrderLines(OrderLines&& other) noexcept : block(other.block), count(other.count) {
+        other.block = nullptr;
+        other.count = 0;
+    }
+
+    OrderLines& operator=(OrderLines&& other) noexcept {
+        if (this != &other) {
+            release();
+            block = other.block;
+            count = other.count;
+            other.block = nullptr;
+            other.count = 0;
+        }
+        return *this;
+    }
+
+    // Destructor
+    ~OrderLines() {
+        release();
+    }
+
+    // Line at a position
+    CartItem operator[](int i) const {
+        return CartItem(products()[i].get(), Money::fromCentavos(unitPrices()[i]), quantities()[i]);
+    }
+
+    // Product of a line
+    const Product* productAt(int i) const {
+        return products()[i].get();
+    }
+
+    // Getters
+    int size() const { return static_cast<int>(count); }
+    bool empty() const { return count == 0; }
+
+    // Sum of all line totals
+    Money total() const {
+        return Money::fromCentavos(sumLineTotals(unitPrices(), quantities(), count));
+    }
+};
+
+// Small open-addressing index from product to its line, so a cart holds one line per product
+class LineIndex {
+private:
+    static const size_t INLINE_SLOTS = 32;
+
+    SmallVector<int32_t, INLINE_SLOTS> slots; // line position, -1 when empty
+    size_t count;
+
+    void place(const ProductKey& key, int32_t line) {
+        size_t mask = slots.size() - 1;
+        size_t i = static_cast<size_t>(key.hash()) & mask;
+        while (slots[i] != -1) {
+            i = (i + 1) & mask;
+        }
+        slots[i] = line;
+    }
+
+public:
+    // Constructor
+    LineIndex() : count(0) {
+        slots.assign(INLINE_SLOTS, -1);
+    }
+
+    // Line holding a product ID, or -1. Keyed on the ID rather than the Product
+    // address, so the same SKU from two catalog snapshots shares one line.
+    int32_t find(const ProductKey& key, const LineItems& items) const {
+        size_t mask = slots.size() - 1;
+        size_t i = static_cast<size_t>(key.hash()) & mask;
+        while (slots[i] != -1) {
+            if (items.productAt(slots[i])->getKey() == key) {
+                return slots[i];
+            }
+            i = (i + 1) & mask;
+        }
+        return -1;
+    }
+
+    // Record a new line; doubles and rehashes from the lines when half full
+    void insert(const ProductKey& key, int32_t line, const LineItems& items) {
+        if ((count + 1) * 2 > slots.size()) {
+            slots.assign(slots.size() * 2, -1);
+            for (int i = 0; i < items.size(); i++) {
+                if (i != line) {
+                    place(items.productAt(i)->getKey(), i);
+                }
+            }
+        }
+        place(key, line);
+        count++;
+    }
+
+    // Forget all lines
+    void clear() {
+        slots.assign(INLINE_SLOTS, -1);
+        count = 0;
+    }
+
+    // Re-index every line after lines have moved
+    void rebuild(const LineItems& items) {
+        size_t capacity = INLINE_SLOTS;
+        while (capacity < static_cast<size_t>(items.size()) * 2) {
+            capacity <<= 1;
+        }
+        slots.assign(capacity, -1);
+        for (int i = 0; i < items.size(); i++) {
+            place(items.productAt(i)->getKey(), i);
+        }
+        count = items.size();
+    }
+};
+
+// Order class
+class Order {
+private:
+    int orderId;
+    bool initialized;
+    Money totalAmount;
+    OrderLines items;
+    string paymentMethod;
+    
+public:
+    // Default constructor
+    Order() : orderId(0), initialized(false), totalAmount(), paymentMethod("") {}
+    
+    // Constructor taking over the lines of a checked-out cart
+    Order(int _orderId, LineItems&& _items, string _paymentMethod)
+        : orderId(_orderId), initialized(true), totalAmount(), items(move(_items)),
+          paymentMethod(move(_paymentMethod)) {
+        calculateTotal();
+    }
+
+    // Orders are moved, never copied
+    Order(const Order&) = delete;
+    Order& operator=(const Order&) = delete;
+    Order(Order&&) = default;
+    Order& operator=(Order&&) = default;
+    
+    // Calculate total amount
+    void calculateTotal() {
+        totalAmount = items.total();
+    }
+    
+    // Getters
+    int getOrderId() const { return orderId; }
+    const OrderLines& getItems() const { return items; }
+    int getItemCount() const { return items.size(); }
+    const string& getPaymentMethod() const { return paymentMethod; }
+    Money getTotalAmount() const { return totalAmount; }
+    bool isInitialized() const { return initialized; }
+    
+    // Display order details
+    void display() const {
+        if (!initialized) return;
+        
+        cout << "\nOrder ID: " << orderId << endl;
+        cout << "Total Amount: " << totalAmount << endl;
+        cout << "Payment Method: " << paymentMethod << endl;
+        cout << "Order Details:" << endl;
+        cout << left << setw(15) << "Product ID" 
+             << setw(20) << "Name" 
+             << setw(10) << "Price" 
+             << setw(10) << "Quantity" << endl;
+        
+        for (int i = 0; i < items.size(); i++) {
+            items[i].display();
+        }
+        cout << endl;
+    }
+};
+
+// Shopping Cart class
+class ShoppingCart {
+private:
+    LineItems items;
+    LineIndex lineIndex;
+    Money runningTotal; // kept in step with every change to items
+
+    // Line holding a product, or ProductNotFoundException
+    int32_t lineOf(const Product* product) const {
+        int32_t line = lineIndex.find(product->getKey(), items);
+        if (line < 0) {
+            throw ProductNotFoundException(product->getId());
+        }
+        return line;
+    }
+
+    // Reserve stock for a product, or OutOfStockException
+    static void reserve(const Product* product, int quantity) {
+        if (!product->reserveStock(quantity)) {
+            throw OutOfStockException(product->getId(), product->getAvailableStock());
+        }
+    }
+
+    // Give back the stock held by every line
+    void releaseAll() {
+        for (int i = 0; i < items.size(); i++) {
+            items.productAt(i)->releaseStock(items[i].getQuantity());
+        }
+    }
+    
+public:
+    // Constructor
+    ShoppingCart() = default;
+
+    // The cart holds stock reservations, so it is not copyable
+    ShoppingCart(const ShoppingCart&) = delete;
+    ShoppingCart& operator=(const ShoppingCart&) = delete;
+
+    // Destructor: an abandoned cart releases its reservations
+    ~ShoppingCart() {
+        releaseAll();
+    }
+
+    // Add item to cart, merging with the product's existing line if there is one.
+    // The quantity is reserved from stock first; an error leaves the cart unchanged.
+    Result<void> tryAddItem(shared_ptr<Product> product, int quantity) {
+        return addItemWith(move(product), quantity, ReturnError());
+    }
+
+    // Add item to cart, or InvalidInputException / OutOfStockException
+    void addItem(shared_ptr<Product> product, int quantity) {
+        addItemWith(move(product), quantity, ThrowError());
+    }
+
+private:
+    template <typename OnError>
+    Result<void> addItemWith(shared_ptr<Product> product, int quantity, OnError onError) {
+        if (quantity <= 0) {
+            return onError(InvalidInputException("Quantity must be a positive whole number."));
+        }
+        int32_t line = lineIndex.find(product->getKey(), items);
+        if (line >= 0 && items[line].getQuantity() > INT32_MAX - quantity) {
+            return onError(InvalidInputException("Quantity is too large."));
+        }
+        // A merged line keeps its own product, so stock moves through that one
+        const Product* stock = line >= 0 ? items.productAt(line) : product.get();
+        if (!stock->reserveStock(quantity)) {
+            return onError(OutOfStockException(stock->getId(), stock->getAvailableStock()));
+        }
+        if (line >= 0) {
+            items.addQuantity(line, quantity);
+            runningTotal += items[line].getUnitPrice() * quantity;
+            return Result<void>();
+        }
+        const Product* added = product.get();
+        try {
+            items.add(move(product), quantity);
+        } catch (...) {
+            added->releaseStock(quantity);
+            throw;
+        }
+        lineIndex.insert(added->getKey(), items.size() - 1, items);
+        runningTotal += items[items.size() - 1].getTotalPrice();
+        return Result<void>();
+    }
+
+public:
+
+    // Change the quantity of a product already in the cart
+    void updateQuantity(const Product* product, int quantity) {
+        if (quantity <= 0) {
+            throw InvalidInputException("Quantity must be a positive whole number.");
+        }
+        int32_t line = lineOf(product);
+        CartItem item = items[line];
+        if (quantity > item.getQuantity()) {
+            reserve(items.productAt(line), quantity - item.getQuantity());
+        } else {
+            items.productAt(line)->releaseStock(item.getQuantity() - quantity);
+        }
+        runningTotal += item.getUnitPrice() * (static_cast<int64_t>(quantity) - item.getQuantity());
+        items.setQuantity(line, quantity);
+    }
+
+    // Remove a product's line from the cart
+    void removeItem(const Product* product) {
+        int32_t line = lineOf(product);
+        items.productAt(line)->releaseStock(items[line].getQuantity());
+        runningTotal -= items[line].getTotalPrice();
+        items.remove(line);
+        lineIndex.rebuild(items);
+    }
+    
+    // Clear cart, releasing its reservations
+    void clear() {
+        releaseAll();
+        items.clear();
+        lineIndex.clear();
+        runningTotal = Money();
+    }
+    
+    // Get items in cart
+    const LineItems& getItems() const {
+        return items;
+    }
+
+    // Hand the lines (and their reservations) over to an order, leaving the cart empty
+    LineItems takeItems() {
+        LineItems taken(move(items));
+        clear();
+        return taken;
+    }
+
+    // Put lines taken by takeItems() back, reservations included, into the emptied cart
+    void restoreItems(LineItems&& taken) {
+        items = move(taken);
+        lineIndex.rebuild(items);
+        runningTotal = items.total();
+    }
+    
+    // Get item count
+    int getItemCount() const {
+        return items.size();
+    }
+    
+    // Running total; debug builds check it against a full recompute
+    Money getTotalAmount() const {
+        assert(runningTotal == items.total());
+        return runningTotal;
+    }
+    
+    // Check if cart is empty
+    bool isEmpty() const {
+        return items.empty();
+    }
+    
+    // Display cart contents
+    void display() const {
+        if (isEmpty()) {
+            cout << "Your shopping cart is empty." << endl;
+            return;
+        }
+        
+        cout << "\n----- Shopping Cart -----" << endl;
+        cout << left << setw(15) << "Product ID" 
+             << setw(20) << "Name" 
+             << setw(10) << "Price" 
+             << setw(10) << "Quantity" << endl;
+        
+        for (int i = 0; i < items.size(); i++) {
+            items[i].display();
+        }
+        
+        cout << "\nTotal Amount: ₱" << getTotalAmount() << endl;
+    }
+};
+
+// Open-addressing (linear probing) index from product key to catalog position
+class ProductIndex {
+private:
+    struct Slot {
+        ProductKey key;
+        int32_t position; // -1 marks an empty slot
+    };
+
+    vector<Slot> slots;
+    size_t mask;
+    size_t count;
+
+public:
+    // Constructor
+    ProductIndex() : mask(0), count(0) {}
+
+    // Size the table for the expected number of products (load factor <= 0.5)
+    void reserve(size_t expected) {
+        size_t capacity = 16;
+        while (capacity < expected * 2) {
+            capacity <<= 1;
+        }
+        Slot empty;
+        empty.position = -1;
+        slots.assign(capacity, empty);
+        mask = capacity - 1;
+        count = 0;
+    }
+
+    // Insert a key, doubling the table when it would pass half full; false if already present
+    bool insert(const ProductKey& key, int32_t position) {
+        if ((count + 1) * 2 > slots.size()) {
+            vector<Slot> old;
+            old.swap(slots);
+            reserve(max<size_t>(count + 1, old.size()));
+            for (const Slot& slot : old) {
+                if (slot.position != -1) {
+                    insert(slot.key, slot.position);
+                }
+            }
+        }
+        size_t i = key.hash() & mask;
+        while (slots[i].position != -1) {
+            if (slots[i].key == key) {
+                return false;
+            }
+            i = (i + 1) & mask;
+        }
+        slots[i].key = key;
+        slots[i].position = position;
+        count++;
+        return true;
+    }
+
+    // Catalog position for a key, or -1 if absent
+    int32_t find(const ProductKey& key) const {
+        if (slots.empty()) {
+            return -1;
+        }
+        size_t i = key.hash() & mask;
+        while (slots[i].position != -1) {
+            if (slots[i].key == key) {
+                return slots[i].position;
+            }
+            i = (i + 1) & mask;
+        }
+        return -1;
+    }
+};
+
+// Writes a file under a temporary name and renames it over the target on
+// commit(), so processes that have the old file open or mapped keep reading
+// a complete copy. Dropped without commit(), the temporary file is removed.
+class FileReplacement {
+private:
+    string path;
+    string temporaryPath;
+    int fd;
+    bool ok;
+
+    void closeFile() {
+        if (fd >= 0) {
+#ifdef _WIN32
+            _close(fd);
+#else
+            ::close(fd);
+#endif
+            fd = -1;
+        }
+    }
+
+public:
+    // Constructor creating the temporary file
+    explicit FileReplacement(const string& _path) : path(_path), temporaryPath(_path + ".tmp") {
+#ifdef _WIN32
+        fd = _open(temporaryPath.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+        fd = ::open(temporaryPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+#endif
+        ok = fd >= 0;
+    }
+
+    FileReplacement(const FileReplacement&) = delete;
+    FileReplacement& operator=(const FileReplacement&) = delete;
+
+    // Destructor discarding an uncommitted temporary file
+    ~FileReplacement() {
+        if (fd >= 0) {
+            closeFile();
+            remove(temporaryPath.c_str());
+        }
+    }
+
+    // Append bytes; a failure makes commit() fail
+    void write(const void* data, size_t size) {
+        const char* bytes = static_cast<const char*>(data);
+        while (ok && size > 0) {
+#ifdef _WIN32
+            int written = _write(fd, bytes, static_cast<unsigned int>(min<size_t>(size, 1 << 30)));
+#else
+            ssize_t written = ::write(fd, bytes, size);
+            if (written < 0 && errno == EINTR) {
+                continue;
+            }
+#endif
+            if (written <= 0) {
+                ok = false;
+                break;
+            }
+            bytes += written;
+            size -= static_cast<size_t>(written);
+        }
+    }
+
+    // Flush the temporary file to disk, rename it over the target, then fsync the directory
+    bool commit() {
+        if (!ok) {
+            return false;
+        }
+#ifdef _WIN32
+        ok = _commit(fd) == 0;
+        closeFile();
+        if (!ok || !MoveFileExA(temporaryPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+            remove(temporaryPath.c_str());
+            return false;
+        }
+#else
+        ok = fsync(fd) == 0;
+        closeFile();
+        if (!ok || rename(temporaryPath.c_str(), path.c_str()) != 0) {
+            remove(temporaryPath.c_str());
+            return false;
+        }
+        size_t slash = path.find_last_of('/');
+        string directory = slash == string::npos ? "." : path.substr(0, slash + 1);
+        int directoryFd = ::open(directory.c_str(), O_RDONLY | O_CLOEXEC);
+        if (directoryFd >= 0) {
+            fsync(directoryFd);
+            ::close(directoryFd);
+        }
+#endif
+        return true;
+    }
+};
+
+// Read-only memory mapping of a whole file
+class MappedFile {
+private:
+    const char* data;
+    size_t size;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#endif
+
+    void close() {
+#ifdef _WIN32
+        if (data) UnmapViewOfFile(data);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        file = INVALID_HANDLE_VALUE;
+        mapping = nullptr;
+#else
+        if (data) munmap(const_cast<char*>(data), size);
+#endif
+        data = nullptr;
+        size = 0;
+    }
+
+public:
+    // Constructor
+#ifdef _WIN32
+    MappedFile() : data(nullptr), size(0), file(INVALID_HANDLE_VALUE), mapping(nullptr) {}
+#else
+    MappedFile() : data(nullptr), size(0) {}
+#endif
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Destructor unmaps the file
+    ~MappedFile() {
+        close();
+    }
+
+    // Map a file; false if it cannot be opened or is empty
+    bool open(const string& path) {
+        close();
+#ifdef _WIN32
+        // Share writes too, so a journal still being appended to can be inspected
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                           OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+            close();
+            return false;
+        }
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        data = mapping ? static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+        if (data == nullptr) {
+            close();
+            return false;
+        }
+        size = static_cast<size_t>(fileSize.QuadPart);
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+        void* mapped = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) {
+            return false;
+        }
+        data = static_cast<const char*>(mapped);
+        size = static_cast<size_t>(info.st_size);
+#endif
+        return true;
+    }
+
+    // Getters
+    const char* getData() const { return data; }
+    size_t getSize() const { return size; }
+};
+
+// Product catalog storage: either a mapped binary catalog or columns parsed from text
+class Catalog {
+private:
+    static constexpr char MAGIC[8] = {'D', 'B', 'C', 'A', 'T', 'L', 'G', '1'};
+    static const uint32_t VERSION = 4;
+
+    MappedFile mapping;
+    vector<ProductKey> ownedIds;
+    vector<int64_t> ownedPrices;
+    vector<uint32_t> ownedNameOffsets;
+    vector<int32_t> ownedStock;
+    string ownedNames;
+    // One contiguous array of live stock counters
+    struct StockBlock {
+        shared_ptr<StockCounter> counters;
+        size_t count;
+
+        bool holds(const StockCounter* counter) const {
+            return !less<const StockCounter*>()(counter, counters.get()) &&
+                   less<const StockCounter*>()(counter, counters.get() + count);
+        }
+    };
+
+    vector<StockBlock> stockBlocks; // blocks the products count in; the first is this catalog's own
+    vector<StockCounter*> counterRefs;
+    ProductColumns columns;
+    vector<Product> products;
+
+    // Start the live stock counters from the initial stock column, then build the views
+    void buildViews() {
+        StockBlock own{shared_ptr<StockCounter>(new StockCounter[columns.count], default_delete<StockCounter[]>()),
+                       columns.count};
+        counterRefs.resize(columns.count);
+        for (size_t i = 0; i < columns.count; i++) {
+            own.counters.get()[i].available.store(columns.stock[i], memory_order_relaxed);
+            own.counters.get()[i].reserved.store(0, memory_order_relaxed);
+            counterRefs[i] = own.counters.get() + i;
+        }
+        stockBlocks.assign(1, move(own));
+        columns.counters = counterRefs.data();
+
+        products.clear();
+        products.reserve(columns.count);
+        for (size_t i = 0; i < columns.count; i++) {
+            products.emplace_back(&columns, static_cast<uint32_t>(i));
+        }
+    }
+
+public:
+    // Constructor
+    Catalog() : columns{nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, 0} {}
+
+    Catalog(const Catalog&) = delete;
+    Catalog& operator=(const Catalog&) = delete;
+
+    // Append one product to the owned columns; false if the ID or price is invalid.
+    // Products become visible through getProducts() after finishOwned().
+    bool addProduct(const char* id, size_t idLength, const char* name, size_t nameLength, Money price,
+                    int32_t stock = UNLIMITED_STOCK) {
+        ProductKey key;
+        if (!ProductKey::normalize(id, idLength, key) ||
+            price.getCentavos() < 0 || price.getCentavos() > MAX_UNIT_CENTAVOS || stock < 0) {
+            return false;
+        }
+        ownedIds.push_back(key);
+        ownedPrices.push_back(price.getCentavos());
+        ownedStock.push_back(stock);
+        ownedNames.append(name, nameLength);
+        ownedNameOffsets.push_back(static_cast<uint32_t>(ownedNames.size()));
+        return true;
+    }
+
+    // Point the columns at the owned storage once it stops growing
+    void finishOwned() {
+        columns.ids = ownedIds.data();
+        columns.prices = ownedPrices.data();
+        columns.nameOffsets = ownedNameOffsets.data();
+        columns.stock = ownedStock.data();
+        columns.names = ownedNames.data();
+        columns.count = ownedIds.size();
+        buildViews();
+    }
+
+    // Start a fresh set of owned columns
+    void resetOwned() {
+        ownedIds.clear();
+        ownedPrices.clear();
+        ownedNameOffsets.assign(1, 0);
+        ownedStock.clear();
+        ownedNames.clear();
+    }
+
+    // Map a binary catalog in place; false if the file is missing or not a valid catalog
+    bool loadBinary(const string& path) {
+        if (!mapping.open(path)) {
+            return false;
+        }
+
+        const char* data = mapping.getData();
+        size_t size = mapping.getSize();
+        CatalogHeader header;
+        if (size < sizeof(header)) {
+            return false;
+        }
+        memcpy(&header, data, sizeof(header));
+        if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION) {
+            return false;
+        }
+        uint64_t count = header.productCount;
+        uint64_t idsOffset = sizeof(header);
+        uint64_t pricesOffset = idsOffset + count * sizeof(ProductKey);
+        uint64_t nameOffsetsOffset = pricesOffset + count * sizeof(int64_t);
+        uint64_t stockOffset = nameOffsetsOffset + (count + 1) * sizeof(uint32_t);
+        uint64_t namesOffset = stockOffset + count * sizeof(int32_t);
+        if (size < namesOffset || size - namesOffset < header.namesSize) {
+            return false;
+        }
+
+        columns.ids = reinterpret_cast<const ProductKey*>(data + idsOffset);
+        columns.prices = reinterpret_cast<const int64_t*>(data + pricesOffset);
+        columns.nameOffsets = reinterpret_cast<const uint32_t*>(data + nameOffsetsOffset);
+        columns.stock = reinterpret_cast<const int32_t*>(data + stockOffset);
+        columns.names = data + namesOffset;
+        columns.count = static_cast<size_t>(count);
+        for (size_t i = 0; i < columns.count; i++) {
+            if (columns.nameOffsets[i] > columns.nameOffsets[i + 1] ||
+                columns.prices[i] < 0 || columns.prices[i] > MAX_UNIT_CENTAVOS || columns.stock[i] < 0) {
+                return false;
+            }
+        }
+        if (columns.nameOffsets[0] != 0 || columns.nameOffsets[columns.count] != header.namesSize) {
+            return false;
+        }
+        buildViews();
+        return true;
+    }
+
+    // Parse "ID,Name,Price[,Stock]" lines in a single pass over the file contents;
+    // a product without a stock field is never counted
+    bool loadText(const string& path) {
+        ifstream catalogFile(path, ios::binary | ios::ate);
+        if (!catalogFile) {
+            return false;
+        }
+
+        streamsize size = catalogFile.tellg();
+        string buffer(static_cast<size_t>(size > 0 ? size : 0), '\0');
+        catalogFile.seekg(0);
+        if (!catalogFile.read(&buffer[0], size)) {
+            return false;
+        }
+
+        // One line per product; reserve up front so the columns never reallocate
+        size_t lineCount = 1;
+        for (const char* p = buffer.data(); (p = static_cast<const char*>(
+                 memchr(p, '\n', buffer.data() + buffer.size() - p))) != nullptr; p++) {
+            lineCount++;
+        }
+        resetOwned();
+        ownedIds.reserve(lineCount);
+        ownedPrices.reserve(lineCount);
+        ownedNameOffsets.reserve(lineCount + 1);
+        ownedStock.reserve(lineCount);
+        ownedNames.reserve(buffer.size());
+
+        const char* cursor = buffer.data();
+        const char* end = cursor + buffer.size();
+        int skipped = 0;
+        while (cursor < end) {
+            const char* lineEnd = static_cast<const char*>(memchr(cursor, '\n', end - cursor));
+            if (lineEnd == nullptr) {
+                lineEnd = end;
+            }
+            const char* line = cursor;
+            const char* last = lineEnd;
+            cursor = lineEnd + 1;
+            if (last > line && last[-1] == '\r') {
+                last--;
+            }
+            if (line == last || *line == '#') {
+                continue;
+            }
+
+            const char* comma1 = static_cast<const char*>(memchr(line, ',', last - line));
+            const char* comma2 = comma1 ? static_cast<const char*>(memchr(comma1 + 1, ',', last - comma1 - 1)) : nullptr;
+            if (comma2 == nullptr) {
+                skipped++;
+                continue;
+            }
+
+            const char* comma3 = static_cast<const char*>(memchr(comma2 + 1, ',', last - comma2 - 1));
+            const char* priceEnd = comma3 ? comma3 : last;
+            int32_t stock = UNLIMITED_STOCK;
+            if (comma3 != nullptr && !parseStock(comma3 + 1, last, stock)) {
+                skipped++;
+                continue;
+            }
+
+            Money price;
+            if (!Money::parse(comma2 + 1, priceEnd, price) ||
+                !addProduct(line, comma1 - line, comma1 + 1, comma2 - comma1 - 1, price, stock)) {
+                skipped++;
+            }
+        }
+
+        if (skipped > 0) {
+            cerr << "Warning: Skipped " << skipped << " malformed line(s) in " << path << "." << endl;
+        }
+        finishOwned();
+        return true;
+    }
+
+    // Parse a non-negative whole stock count
+    static bool parseStock(const char* begin, const char* end, int32_t& stock) {
+        if (begin == end) {
+            return false;
+        }
+        int64_t value = 0;
+        for (const char* p = begin; p < end; p++) {
+            if (!isdigit(static_cast<unsigned char>(*p))) {
+                return false;
+            }
+            value = value * 10 + (*p - '0');
+            if (value >= UNLIMITED_STOCK) {
+                return false;
+            }
+        }
+        stock = static_cast<int32_t>(value);
+        return true;
+    }
+
+    // Built-in products used when no catalog file is available
+    void loadDefaults() {
+        resetOwned();
+        addProduct("A1B2C3", 6, "C2 Green Tea", 12, Money::fromCentavos(3200), 50);
+        addProduct("X9Y8Z7", 6, "Zesto Juice Drink", 17, Money::fromCentavos(1400), 80);
+        addProduct("P4Q5R6", 6, "Cobra Energy Drink", 18, Money::fromCentavos(2900), 40);
+        addProduct("M7N8O9", 6, "1.5L Royal", 10, Money::fromCentavos(7500), 25);
+        addProduct("J1K2L3", 6, "Milo", 4, Money::fromCentavos(1250), 100);
+        finishOwned();
+    }
+
+    // Write the loaded catalog in the binary format. The file is replaced by rename,
+    // never rewritten in place, because running processes may have it mapped.
+    bool writeBinary(const string& path) const {
+        FileReplacement out(path);
+        CatalogHeader header;
+        memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version = VERSION;
+        header.productCount = static_cast<uint32_t>(columns.count);
+        header.namesSize = columns.nameOffsets[columns.count];
+        out.write(&header, sizeof(header));
+        out.write(columns.ids, columns.count * sizeof(ProductKey));
+        out.write(columns.prices, columns.count * sizeof(int64_t));
+        out.write(columns.nameOffsets, (columns.count + 1) * sizeof(uint32_t));
+        out.write(columns.stock, columns.count * sizeof(int32_t));
+        out.write(columns.names, header.namesSize);
+        return out.commit();
+    }
+
+    // Take over the live stock of the catalog this one replaces. A product counted in
+    // both shares the older counter, so carts holding either version see one level;
+    // the change in initial stock between the two files is applied to it as a restock
+    // (or cut), once per ID even if this catalog repeats it. Call before any product
+    // is handed out.
+    void carryStock(const Catalog& previous, const ProductIndex& previousIndex) {
+        const ProductColumns& old = previous.columns;
+        vector<bool> carried(old.count, false);
+        vector<bool> blockUsed(previous.stockBlocks.size(), false);
+        size_t block = 0;
+        for (size_t i = 0; i < columns.count; i++) {
+            if (columns.stock[i] == UNLIMITED_STOCK) {
+                continue;
+            }
+            int32_t position = previousIndex.find(columns.ids[i]);
+            if (position < 0 || old.stock[position] == UNLIMITED_STOCK || carried[position]) {
+                continue;
+            }
+            carried[position] = true;
+            StockCounter* counter = old.counters[position];
+            counter->available.fetch_add(columns.stock[i] - old.stock[position], memory_order_relaxed);
+            counterRefs[i] = counter;
+            for (size_t n = 0; !previous.stockBlocks[block].holds(counter) && n < previous.stockBlocks.size(); n++) {
+                block = (block + 1) % previous.stockBlocks.size();
+            }
+            blockUsed[block] = true;
+        }
+        for (size_t b = 0; b < blockUsed.size(); b++) {
+            if (blockUsed[b]) {
+                stockBlocks.push_back(previous.stockBlocks[b]);
+            }
+        }
+    }
+
+    // Get catalog columns
+    const ProductColumns& getColumns() const {
+        return columns;
+    }
+
+    // Get product views
+    const vector<Product>& getProducts() const {
+        return products;
+    }
+};
+
+constexpr char Catalog::MAGIC[8];
+
+// One immutable version of the catalog together with its ID index
+struct CatalogSnapshot : enable_shared_from_this<CatalogSnapshot> {
+    Catalog catalog;
+    ProductIndex index;
+
+    // Index every product by its stored (already normalized) ID, dropping duplicates
+    void buildIndex() {
+        const ProductColumns& columns = catalog.getColumns();
+        index.reserve(columns.count);
+        int duplicates = 0;
+        for (size_t i = 0; i < columns.count; i++) {
+            if (!index.insert(columns.ids[i], static_cast<int32_t>(i))) {
+                duplicates++;
+            }
+        }
+        if (duplicates > 0) {
+            cerr << "Warning: Ignored " << duplicates << " duplicate product ID(s)." << endl;
+        }
+    }
+};
+
+// Inventory class for product management. Readers use the current snapshot
+// through one atomic pointer load and never lock; reload() publishes a new
+// snapshot (read-copy-update). Replaced snapshots stay alive until reclaim(),
+// and product handles keep their own snapshot alive for as long as they exist.
+class Inventory {
+private:
+    static const size_t READER_SLOTS = 16;
+
+    // Readers inside a lookup, counted per epoch parity and spread over slots
+    // so concurrent lookups rarely share a cache line
+    struct alignas(64) ReaderSlot {
+        atomic<int64_t> active[2];
+    };
+
+    atomic<CatalogSnapshot*> current;
+    vector<shared_ptr<CatalogSnapshot>> published; // current and retired snapshots
+    mutex publishMutex;
+    atomic<uint64_t> epoch;
+    mutable ReaderSlot readers[READER_SLOTS];
+
+    // Marks the calling thread as inside a lookup for the epoch it entered in;
+    // reclaim() waits for every reader of the previous epoch to leave
+    class ReadGuard {
+    private:
+        atomic<int64_t>* counter;
+
+    public:
+        explicit ReadGuard(const Inventory& inventory) {
+            ReaderSlot& slot = inventory.readers[hash<thread::id>()(this_thread::get_id()) % READER_SLOTS];
+            for (;;) {
+                uint64_t entered = inventory.epoch.load();
+                counter = &slot.active[entered & 1];
+                counter->fetch_add(1);
+                if (inventory.epoch.load() == entered) {
+                    break;
+                }
+                counter->fetch_sub(1); // raced with reclaim(); count against the new epoch instead
+            }
+        }
+
+        ~ReadGuard() { counter->fetch_sub(1, memory_order_release); }
+
+        ReadGuard(const ReadGuard&) = delete;
+        ReadGuard& operator=(const ReadGuard&) = delete;
+    };
+
+    void initReaders() {
+        for (ReaderSlot& slot : readers) {
+            slot.active[0].store(0, memory_order_relaxed);
+            slot.active[1].store(0, memory_order_relaxed);
+        }
+    }
+
+    // Load a catalog file (binary or text), falling back to the built-in products
+    static shared_ptr<CatalogSnapshot> loadSnapshot(const string& catalogPath) {
+        shared_ptr<CatalogSnapshot> snapshot = make_shared<CatalogSnapshot>();
+        if (!snapshot->catalog.loadBinary(catalogPath) && !snapshot->catalog.loadText(catalogPath)) {
+            cerr << "Warning: Could not load catalog from " << catalogPath << ". Using built-in products." << endl;
+            snapshot->catalog.loadDefaults();
+        }
+        snapshot->buildIndex();
+        return snapshot;
+    }
+
+    void publish(shared_ptr<CatalogSnapshot> snapshot) {
+        lock_guard<mutex> lock(publishMutex);
+        CatalogSnapshot* previous = current.load(memory_order_relaxed);
+        if (previous) {
+            snapshot->catalog.carryStock(previous->catalog, previous->index);
+        }
+        current.store(snapshot.get(), memory_order_release);
+        published.push_back(move(snapshot));
+    }
+
+public:
+    // Constructor preferring the binary catalog, then the text catalog, then the built-in products
+    Inventory() : current(nullptr), epoch(0) {
+        initReaders();
+        shared_ptr<CatalogSnapshot> snapshot = make_shared<CatalogSnapshot>();
+        if (!snapshot->catalog.loadBinary("catalog.bin") && !snapshot->catalog.loadText("catalog.txt")) {
+            cerr << "Warning: Could not load catalog.bin or catalog.txt. Using built-in products." << endl;
+            snapshot->catalog.loadDefaults();
+        }
+        snapshot->buildIndex();
+        publish(move(snapshot));
+    }
+
+    // Constructor loading a specific catalog file (binary or text)
+    explicit Inventory(const string& catalogPath) : current(nullptr), epoch(0) {
+        initReaders();
+        publish(loadSnapshot(catalogPath));
+    }
+
+    Inventory(const Inventory&) = delete;
+    Inventory& operator=(const Inventory&) = delete;
+
+    // Swap in a new catalog; lookups already running finish on the old one. Stock
+    // levels carry over by product ID, keeping carts' reservations, and change by as
+    // much as the file's initial stock for that ID changed.
+    void reload(const string& catalogPath) {
+        publish(loadSnapshot(catalogPath));
+    }
+
+    // Drop replaced snapshots once every lookup that could still see them has
+    // finished. Products already handed out keep their snapshot alive regardless.
+    void reclaim() {
+        lock_guard<mutex> lock(publishMutex);
+        CatalogSnapshot* live = current.load(memory_order_relaxed);
+        // Readers entering from here on count against the new epoch and can only
+        // load the live snapshot; wait out the ones still in the old epoch
+        uint64_t previous = epoch.fetch_add(1);
+        for (;;) {
+            int64_t active = 0;
+            for (const ReaderSlot& slot : readers) {
+                active += slot.active[previous & 1].load();
+            }
+            if (active == 0) {
+                break;
+            }
+            this_thread::yield();
+        }
+        published.erase(remove_if(published.begin(), published.end(),
+                                  [live](const shared_ptr<CatalogSnapshot>& snapshot) { return snapshot.get() != live; }),
+                        published.end());
+    }
+
+    // Hash lookup on the normalized ID; lock-free, and allocation-free on both paths
+    Result<shared_ptr<Product>> tryFindProduct(string_view id) const {
+        shared_ptr<Product> product = lookup(id);
+        if (!product) {
+            return ProductNotFoundException(id);
+        }
+        return product;
+    }
+
+    // Find a product by ID, or ProductNotFoundException
+    shared_ptr<Product> findProduct(const string& id) const {
+        shared_ptr<Product> product = lookup(id);
+        if (!product) {
+            throw ProductNotFoundException(id);
+        }
+        return product;
+    }
+
+private:
+    // Product for an ID, or nullptr
+    shared_ptr<Product> lookup(string_view id) const {
+        ReadGuard guard(*this);
+        const CatalogSnapshot* snapshot = current.load(memory_order_acquire);
+        ProductKey key;
+        if (ProductKey::normalize(id.data(), id.length(), key)) {
+            int32_t position = snapshot->index.find(key);
+            if (position >= 0) {
+                return shared_ptr<Product>(const_cast<CatalogSnapshot*>(snapshot)->shared_from_this(),
+                                           const_cast<Product*>(&snapshot->catalog.getProducts()[position]));
+            }
+        }
+        return nullptr;
+    }
+
+public:
+
+    // Get product count
+    size_t getProductCount() const {
+        ReadGuard guard(*this);
+        return current.load(memory_order_acquire)->catalog.getProducts().size();
+    }
+    
+    // Display all products
+    void displayProducts() const {
+        cout << "\n----- Available Products -----" << endl;
+        cout << left << setw(15) << "Product ID" 
+             << setw(20) << "Name" 
+             << setw(10) << "Price"
+             << "Stock" << endl;
+        
+        ReadGuard guard(*this);
+        for (const Product& product : current.load(memory_order_acquire)->catalog.getProducts()) {
+            product.display();
+        }
+    }
+};
+
+// Append-only order storage. Orders live in fixed-size chunks, so appending never
+// moves an existing order, and an open-addressing index maps order ID to position.
+class OrderStore {
+private:
+    static const size_t CHUNK_ORDERS = 1024;
+
+    struct Slot {
+        int orderId; // 0 marks an empty slot
+        uint32_t chunk;
+        uint32_t offset;
+    };
+
+    vector<Order*> chunks;
+    size_t count;
+    vector<Slot> slots;
+    size_t mask;
+
+    static size_t hashId(int orderId) {
+        return static_cast<size_t>((static_cast<uint64_t>(static_cast<uint32_t>(orderId)) * 0x9E3779B97F4A7C15ULL) >> 32);
+    }
+
+    void place(const Slot& slot) {
+        size_t i = hashId(slot.orderId) & mask;
+        while (slots[i].orderId != 0) {
+            i = (i + 1) & mask;
+        }
+        slots[i] = slot;
+    }
+
+    // Double the index when it would pass half full
+    void growIndex() {
+        vector<Slot> old(slots.size() * 2, Slot{0, 0, 0});
+        old.swap(slots);
+        mask = slots.size() - 1;
+        for (const Slot& slot : old) {
+            if (slot.orderId != 0) {
+                place(slot);
+            }
+        }
+    }
+
+    const Slot* findSlot(int orderId) const {
+        size_t i = hashId(orderId) & mask;
+        while (slots[i].orderId != 0) {
+            if (slots[i].orderId == orderId) {
+                return &slots[i];
+            }
+            i = (i + 1) & mask;
+        }
+        return nullptr;
+    }
+
+public:
+    // Constructor
+    OrderStore() : count(0), slots(64, Slot{0, 0, 0}), mask(63) {}
+
+    OrderStore(const OrderStore&) = delete;
+    OrderStore& operator=(const OrderStore&) = delete;
+
+    // Destructor
+    ~OrderStore() {
+        for (size_t i = 0; i < count; i++) {
+            (*this)[i].~Order();
+        }
+        for (Order* chunk : chunks) {
+            ::operator delete(chunk);
+        }
+    }
+
+    // Construct an order in place at the end of the store
+    template <typename... Args>
+    Order& emplace(int orderId, Args&&... args) {
+        if (orderId <= 0 || findSlot(orderId) != nullptr) {
+            throw ECommerceException("Order ID " + to_string(orderId) + " is invalid or already stored.");
+        }
+        if (count >= UINT32_MAX) {
+            throw ArrayFullException("Order store");
+        }
+        try {
+            if (count == chunks.size() * CHUNK_ORDERS) {
+                chunks.reserve(chunks.size() + 1);
+                chunks.push_back(static_cast<Order*>(::operator new(CHUNK_ORDERS * sizeof(Order))));
+            }
+            if ((count + 1) * 2 > slots.size()) {
+                growIndex();
+            }
+        } catch (const bad_alloc&) {
+            throw ArrayFullException("Order store");
+        }
+
+        uint32_t chunk = static_cast<uint32_t>(count / CHUNK_ORDERS);
+        uint32_t offset = static_cast<uint32_t>(count % CHUNK_ORDERS);
+        Order* order = new (&chunks[chunk][offset]) Order(orderId, forward<Args>(args)...);
+        place(Slot{orderId, chunk, offset});
+        count++;
+        return *order;
+    }
+
+    // Order by ID, or nullptr
+    const Order* find(int orderId) const {
+        const Slot* slot = findSlot(orderId);
+        return slot ? &chunks[slot->chunk][slot->offset] : nullptr;
+    }
+
+    // Order by position, oldest first
+    Order& operator[](size_t i) { return chunks[i / CHUNK_ORDERS][i % CHUNK_ORDERS]; }
+    const Order& operator[](size_t i) const { return chunks[i / CHUNK_ORDERS][i % CHUNK_ORDERS]; }
+
+    // Get order count
+    size_t size() const { return count; }
+};
+
+// Order storage split into independently locked shards by order ID, so
+// concurrent checkouts rarely contend on the same lock
+class ShardedOrderStore {
+private:
+    static const size_t SHARD_COUNT = 16;
+
+    struct alignas(64) Shard {
+        mutable mutex lock;
+        OrderStore orders;
+    };
+
+    Shard shards[SHARD_COUNT];
+    atomic<size_t> count;
+
+    Shard& shardFor(int orderId) { return shards[static_cast<uint32_t>(orderId) % SHARD_COUNT]; }
+    const Shard& shardFor(int orderId) const { return shards[static_cast<uint32_t>(orderId) % SHARD_COUNT]; }
+
+public:
+    // Constructor
+    ShardedOrderStore() : count(0) {}
+
+    // Construct an order in place in its shard; the order never moves afterwards
+    template <typename... Args>
+    const Order& emplace(int orderId, Args&&... args) {
+        Shard& shard = shardFor(orderId);
+        lock_guard<mutex> lock(shard.lock);
+        const Order& order = shard.orders.emplace(orderId, forward<Args>(args)...);
+        count.fetch_add(1, memory_order_relaxed);
+        return order;
+    }
+
+    // Order by ID, or nullptr
+    const Order* find(int orderId) const {
+        const Shard& shard = shardFor(orderId);
+        lock_guard<mutex> lock(shard.lock);
+        return shard.orders.find(orderId);
+    }
+
+    // All orders sorted by ID
+    vector<const Order*> getOrdersById() const {
+        vector<const Order*> result;
+        result.reserve(size());
+        for (const Shard& shard : shards) {
+            lock_guard<mutex> lock(shard.lock);
+            for (size_t i = 0; i < shard.orders.size(); i++) {
+                result.push_back(&shard.orders[i]);
+            }
+        }
+        sort(result.begin(), result.end(), [](const Order* a, const Order* b) {
+            return a->getOrderId() < b->getOrderId();
+        });
+        return result;
+    }
+
+    // Get order count
+    size_t size() const {
+        return count.load(memory_order_relaxed);
+    }
+};
+
+// How hard the order log works to survive a crash
+enum class DurabilityMode {
+    None,            // hand batches to the OS; a crash can lose the last batch
+    GroupCommitFsync // fsync after every batch, so each batch is durable once flushed
+};
+
+// Append-only log file kept open for the process lifetime. Records are batched
+// in memory and written when the batch reaches flushBytes or is older than
+// flushInterval (checked on each append), and always on flush() and destruction.
+class OrderLog {
+private:
+    int fd;
+    string path;
+    string buffer;
+    atomic<DurabilityMode> durability;
+    atomic<size_t> flushBytes;
+    atomic<int64_t> flushIntervalMs;
+    chrono::steady_clock::time_point oldestPending;
+
+    bool batchIsOld() const {
+        return chrono::steady_clock::now() - oldestPending >= chrono::milliseconds(flushIntervalMs.load(memory_order_relaxed));
+    }
+
+    static int openAppend(const string& filePath) {
+#ifdef _WIN32
+        return _open(filePath.c_str(), _O_WRONLY | _O_APPEND | _O_CREAT | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+        return ::open(filePath.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+#endif
+    }
+
+    static bool writeAll(int fileFd, const char* data, size_t size) {
+        while (size > 0) {
+#ifdef _WIN32
+            int written = _write(fileFd, data, static_cast<unsigned int>(min<size_t>(size, INT32_MAX)));
+#else
+            ssize_t written = ::write(fileFd, data, size);
+            if (written < 0 && errno == EINTR) {
+                continue;
+            }
+#endif
+            if (written <= 0) {
+                return false;
+            }
+            data += written;
+            size -= static_cast<size_t>(written);
+        }
+        return true;
+    }
+
+    static bool syncFile(int fileFd) {
+#ifdef _WIN32
+        return _commit(fileFd) == 0;
+#else
+        return fsync(fileFd) == 0;
+#endif
+    }
+
+public:
+    // Constructor opening (or creating) the log for appending
+    OrderLog(const string& _path, DurabilityMode _durability = DurabilityMode::None,
+             size_t _flushBytes = 64 * 1024, chrono::milliseconds _flushInterval = chrono::milliseconds(1000))
+        : fd(openAppend(_path)), path(_path), durability(_durability),
+          flushBytes(_flushBytes), flushIntervalMs(_flushInterval.count()) {
+        if (fd < 0) {
+            cerr << "Warning: Could not open log file " << path << "." << endl;
+        }
+        buffer.reserve(flushBytes + 256);
+    }
+
+    OrderLog(const OrderLog&) = delete;
+    OrderLog& operator=(const OrderLog&) = delete;
+
+    // Destructor writes out anything still batched
+    ~OrderLog() {
+        flush();
+        if (fd >= 0) {
+#ifdef _WIN32
+            _close(fd);
+#else
+            ::close(fd);
+#endif
+        }
+    }
+
+    // Queue one record; writes the batch if a threshold has been reached
+    void append(const char* data, size_t size) {
+        if (buffer.empty()) {
+            oldestPending = chrono::steady_clock::now();
+        }
+        buffer.append(data, size);
+        if (buffer.size() >= flushBytes.load(memory_order_relaxed) || batchIsOld()) {
+            flush();
+        }
+    }
+
+    // Write the batch only if it has waited longer than the flush interval
+    bool flushIfDue() {
+        return buffer.empty() || !batchIsOld() || flush();
+    }
+
+    // Write the current batch, syncing it in group-commit mode
+    bool flush() {
+        if (buffer.empty()) {
+            return true;
+        }
+        bool ok = fd >= 0 && writeAll(fd, buffer.data(), buffer.size());
+        if (ok && getDurability() == DurabilityMode::GroupCommitFsync) {
+            ok = syncFile(fd);
+        }
+        if (!ok) {
+            cerr << "Warning: Failed to write " << buffer.size() << " bytes to " << path << "." << endl;
+        }
+        buffer.clear();
+        return ok;
+    }
+
+    // Settings; safe to change while another thread is writing
+    void setDurability(DurabilityMode mode) { durability.store(mode, memory_order_relaxed); }
+    void setFlushThresholds(size_t bytes, chrono::milliseconds interval) {
+        flushBytes.store(bytes, memory_order_relaxed);
+        flushIntervalMs.store(interval.count(), memory_order_relaxed);
+    }
+    DurabilityMode getDurability() const { return durability.load(memory_order_relaxed); }
+};
+
+// Lock-free bounded multi-producer/single-consumer queue of byte records, using
+// per-slot sequence numbers (Vyukov). Records up to INLINE_BYTES are copied into
+// the slot itself; larger ones carry their own heap copy.
+class LogRecordQueue {
+public:
+    // Room for a journal record of a full inline cart (LineItems::INLINE_LINES lines
+    // with names up to about 27 bytes: ~46 bytes of order header plus ~57 per line),
+    // so checkouts only copy into the cell; larger records fall back to the heap
+    static const size_t INLINE_BYTES = 616;
+
+private:
+    struct Cell {
+        atomic<size_t> sequence;
+        uint32_t size;
+        char* overflow;
+        char data[INLINE_BYTES];
+    };
+    static_assert(sizeof(Cell) % 64 == 0, "cells fill whole cache lines");
+
+    unique_ptr<Cell[]> cells;
+    size_t mask;
+    alignas(64) atomic<size_t> enqueuePosition;
+    alignas(64) size_t dequeuePosition; // only touched by the consumer
+
+public:
+    // Constructor; capacity is rounded up to a power of two
+    explicit LogRecordQueue(size_t capacity) : enqueuePosition(0), dequeuePosition(0) {
+        size_t rounded = 2;
+        while (rounded < capacity) {
+            rounded <<= 1;
+        }
+        cells.reset(new Cell[rounded]);
+        mask = rounded - 1;
+        for (size_t i = 0; i < rounded; i++) {
+            cells[i].sequence.store(i, memory_order_relaxed);
+            cells[i].overflow = nullptr;
+        }
+    }
+
+    // Destructor frees records that were never consumed
+    ~LogRecordQueue() {
+        for (size_t i = 0; i <= mask; i++) {
+            delete[] cells[i].overflow;
+        }
+    }
+
+    // Producer side; false if the queue is full
+    bool tryPush(const char* data, size_t size) {
+        size_t position = enqueuePosition.load(memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &cells[position & mask];
+            size_t sequence = cell->sequence.load(memory_order_acquire);
+            intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+            if (difference == 0) {
+                if (enqueuePosition.compare_exchange_weak(position, position + 1, memory_order_relaxed)) {
+                    break;
+                }
+            } else if (difference < 0) {
+                return false;
+            } else {
+                position = enqueuePosition.load(memory_order_relaxed);
+            }
+        }
+
+        cell->size = static_cast<uint32_t>(size);
+        if (size <= INLINE_BYTES) {
+            memcpy(cell->data, data, size);
+        } else {
+            cell->overflow = new char[size];
+            memcpy(cell->overflow, data, size);
+        }
+        cell->sequence.store(position + 1, memory_order_release);
+        return true;
+    }
+
+    // Consumer side; hands the oldest record to consume(data, size), false if empty
+    template <typename Consumer>
+    bool tryPop(Consumer consume) {
+        Cell* cell = &cells[dequeuePosition & mask];
+        if (cell->sequence.load(memory_order_acquire) != dequeuePosition + 1) {
+            return false;
+        }
+        if (cell->overflow) {
+            consume(cell->overflow, cell->size);
+            delete[] cell->overflow;
+            cell->overflow = nullptr;
+        } else {
+            consume(cell->data, cell->size);
+        }
+        cell->sequence.store(dequeuePosition + mask + 1, memory_order_release);
+        dequeuePosition++;
+        return true;
+    }
+};
+
+// Order log fed through a lock-free queue and written by a dedicated thread, so
+// callers only pay for a queue push. Destruction drains the queue and flushes.
+class AsyncOrderLog {
+private:
+    OrderLog log;
+    LogRecordQueue queue;
+    atomic<bool> stopping;
+    atomic<bool> writerIdle;
+    mutex idleMutex;
+    condition_variable wakeUp;
+    thread writer; // started last, after everything it uses
+
+    void drain() {
+        while (queue.tryPop([this](const char* data, size_t size) { log.append(data, size); })) {
+        }
+    }
+
+    void writerLoop() {
+        for (;;) {
+            bool stopRequested = stopping.load(memory_order_acquire);
+            drain();
+            if (stopRequested) {
+                log.flush();
+                return;
+            }
+
+            // Group commit: everything drained so far goes out as one synced batch
+            if (log.getDurability() == DurabilityMode::GroupCommitFsync) {
+                log.flush();
+            } else {
+                log.flushIfDue();
+            }
+
+            writerIdle.store(true, memory_order_seq_cst);
+            {
+                unique_lock<mutex> lock(idleMutex);
+                wakeUp.wait_for(lock, chrono::milliseconds(10));
+            }
+            writerIdle.store(false, memory_order_relaxed);
+        }
+    }
+
+public:
+    // Constructor starting the writer thread
+    AsyncOrderLog(const string& path, DurabilityMode durability = DurabilityMode::None, size_t queueCapacity = 4096)
+        : log(path, durability), queue(queueCapacity), stopping(false), writerIdle(false),
+          writer(&AsyncOrderLog::writerLoop, this) {}
+
+    AsyncOrderLog(const AsyncOrderLog&) = delete;
+    AsyncOrderLog& operator=(const AsyncOrderLog&) = delete;
+
+    // Destructor drains the queue and stops the writer
+    ~AsyncOrderLog() {
+        stopping.store(true, memory_order_release);
+        wakeUp.notify_one();
+        writer.join();
+    }
+
+    // Queue one record; only waits if the writer has fallen a full queue behind
+    void append(const char* data, size_t size) {
+        while (!queue.tryPush(data, size)) {
+            wakeUp.notify_one();
+            this_thread::yield();
+        }
+        if (writerIdle.load(memory_order_seq_cst)) {
+            wakeUp.notify_one();
+        }
+    }
+
+    // Get the underlying log's settings
+    void setDurability(DurabilityMode mode) { log.setDurability(mode); }
+    void setFlushThresholds(size_t bytes, chrono::milliseconds interval) { log.setFlushThresholds(bytes, interval); }
+    DurabilityMode getDurability() const { return log.getDurability(); }
+};
+
+// Cut a file down to a given size
+bool truncateFile(const string& path, size_t size) {
+#ifdef _WIN32
+    int fd = _open(path.c_str(), _O_WRONLY | _O_BINARY);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = _chsize_s(fd, static_cast<__int64>(size)) == 0;
+    _close(fd);
+    return ok;
+#else
+    return truncate(path.c_str(), static_cast<off_t>(size)) == 0;
+#endif
+}
+
+// Replace a file's contents atomically and durably: write a temporary file,
+// fsync it, rename it over the target, then fsync the directory
+bool replaceFileDurably(const string& path, const string& contents) {
+    FileReplacement replacement(path);
+    replacement.write(contents.data(), contents.size());
+    return replacement.commit();
+}
+
+// CRC-32 (IEEE 802.3, reflected polynomial 0xEDB88320), slicing by 8 bytes
+uint32_t crc32(const char* data, size_t size) {
+    static const struct Tables {
+        uint32_t entries[8][256];
+        Tables() {
+            for (uint32_t i = 0; i < 256; i++) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; k++) {
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                }
+                entries[0][i] = c;
+            }
+            for (uint32_t i = 0; i < 256; i++) {
+                for (int t = 1; t < 8; t++) {
+                    entries[t][i] = (entries[t - 1][i] >> 8) ^ entries[0][entries[t - 1][i] & 0xFF];
+                }
+            }
+        }
+    } tables;
+    const uint32_t (*t)[256] = tables.entries;
+
+    uint32_t crc = 0xFFFFFFFFu;
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+    for (; size >= 8; size -= 8, p += 8) {
+        uint32_t low, high;
+        memcpy(&low, p, 4);
+        memcpy(&high, p + 4, 4);
+        low ^= crc;
+        crc = t[7][low & 0xFF] ^ t[6][(low >> 8) & 0xFF] ^ t[5][(low >> 16) & 0xFF] ^ t[4][low >> 24] ^
+              t[3][high & 0xFF] ^ t[2][(high >> 8) & 0xFF] ^ t[1][(high >> 16) & 0xFF] ^ t[0][high >> 24];
+    }
+    for (; size > 0; size--, p++) {
+        crc = t[0][(crc ^ *p) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+// One order line as read back from the journal; names point into the journal mapping
+struct JournalLine {
+    ProductKey productId;
+    string_view productName;
+    Money unitPrice;
+    int32_t quantity;
+};
+
+// One order as read back from the journal; reused across records to avoid allocation
+struct JournalOrder {
+    int orderId;
+    Money totalAmount;
+    string_view paymentMethod;
+    vector<JournalLine> lines;
+};
+
+// Binary order journal. Each record is
+//   u32 payloadSize | u32 crc32(payload) | payload
+// and the payload (little-endian) is
+//   u8 version | i32 orderId | i64 totalCentavos | u8 methodLength | method
+//   | u32 lineCount | lineCount x (16-byte product ID | i64 unitCentavos | i32 quantity
+//                                  | u16 nameLength | name)
+class OrderJournal {
+private:
+    static const uint8_t VERSION = 1;
+
+    template <typename T>
+    static void put(string& out, T value) {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    template <typename T>
+    static bool get(const char*& cursor, const char* end, T& value) {
+        if (static_cast<size_t>(end - cursor) < sizeof(value)) {
+            return false;
+        }
+        memcpy(&value, cursor, sizeof(value));
+        cursor += sizeof(value);
+        return true;
+    }
+
+    static bool getBytes(const char*& cursor, const char* end, size_t size, string_view& bytes) {
+        if (static_cast<size_t>(end - cursor) < size) {
+            return false;
+        }
+        bytes = string_view(cursor, size);
+        cursor += size;
+        return true;
+    }
+
+public:
+    static const size_t RECORD_HEADER_BYTES = 8;
+    static const size_t MIN_LINE_BYTES = ProductKey::WIDTH + 8 + 4 + 2; // ID, price, quantity, name length
+
+    // Replace out with the framed record for an order
+    static void encode(const Order& order, string& out) {
+        out.clear();
+        out.append(RECORD_HEADER_BYTES, '\0');
+        const string& method = order.getPaymentMethod();
+        size_t methodLength = min<size_t>(method.size(), UINT8_MAX);
+        const OrderLines& items = order.getItems();
+
+        put<uint8_t>(out, VERSION);
+        put<int32_t>(out, order.getOrderId());
+        put<int64_t>(out, order.getTotalAmount().getCentavos());
+        put<uint8_t>(out, static_cast<uint8_t>(methodLength));
+        out.append(method.data(), methodLength);
+        put<uint32_t>(out, static_cast<uint32_t>(items.size()));
+        for (int i = 0; i < items.size(); i++) {
+            CartItem item = items[i];
+            string_view id = item.getProduct()->getId();
+            string_view name = item.getProduct()->getName();
+            size_t nameLength = min<size_t>(name.size(), UINT16_MAX);
+            char key[ProductKey::WIDTH] = {};
+            memcpy(key, id.data(), min(id.size(), ProductKey::WIDTH));
+            out.append(key, ProductKey::WIDTH);
+            put<int64_t>(out, item.getUnitPrice().getCentavos());
+            put<int32_t>(out, item.getQuantity());
+            put<uint16_t>(out, static_cast<uint16_t>(nameLength));
+            out.append(name.data(), nameLength);
+        }
+
+        uint32_t payloadSize = static_cast<uint32_t>(out.size() - RECORD_HEADER_BYTES);
+        uint32_t checksum = crc32(out.data() + RECORD_HEADER_BYTES, payloadSize);
+        memcpy(&out[0], &payloadSize, sizeof(payloadSize));
+        memcpy(&out[4], &checksum, sizeof(checksum));
+    }
+
+    // Decode a checked payload; false if it is malformed
+    static bool decode(const char* payload, size_t size, JournalOrder& order) {
+        const char* cursor = payload;
+        const char* end = payload + size;
+        uint8_t version, methodLength;
+        int64_t totalCentavos;
+        uint32_t lineCount;
+        if (!get(cursor, end, version) || version != VERSION ||
+            !get(cursor, end, order.orderId) ||
+            !get(cursor, end, totalCentavos) ||
+            !get(cursor, end, methodLength) ||
+            !getBytes(cursor, end, methodLength, order.paymentMethod) ||
+            !get(cursor, end, lineCount)) {
+            return false;
+        }
+        order.totalAmount = Money::fromCentavos(totalCentavos);
+
+        // Every line takes at least MIN_LINE_BYTES, so a bad count cannot force a huge resize
+        if (lineCount > static_cast<size_t>(end - cursor) / MIN_LINE_BYTES) {
+            return false;
+        }
+        order.lines.resize(lineCount);
+        for (JournalLine& line : order.lines) {
+            int64_t unitCentavos;
+            uint16_t nameLength;
+            if (static_cast<size_t>(end - cursor) < ProductKey::WIDTH) {
+                return false;
+            }
+            memcpy(line.productId.chars, cursor, ProductKey::WIDTH);
+            cursor += ProductKey::WIDTH;
+            if (!get(cursor, end, unitCentavos) ||
+                !get(cursor, end, line.quantity) ||
+                !get(cursor, end, nameLength) ||
+                !getBytes(cursor, end, nameLength, line.productName)) {
+                return false;
+            }
+            line.unitPrice = Money::fromCentavos(unitCentavos);
+        }
+        return cursor == end;
+    }
+};
+
+// Sequential reader over a mapped journal. A damaged record in the middle of the
+// file is skipped by scanning forward to the next record that decodes and passes
+// its checksum; reading stops at the end of the file or at damage with no good
+// record after it. getValidBytes() is where the good data ends.
+class JournalReader {
+private:
+    struct DamagedRange {
+        size_t offset;
+        size_t length;
+    };
+
+    MappedFile mapping;
+    size_t offset;
+    vector<DamagedRange> damaged; // found by checked reads, in file order
+    size_t damagedPassed;         // ranges already stepped over since the last rewind
+
+    // Decode the record at position, setting its total length; false if it is torn or corrupt
+    bool readRecord(size_t position, JournalOrder& order, bool verifyChecksum, size_t& length) const {
+        size_t size = mapping.getSize();
+        if (size - position < OrderJournal::RECORD_HEADER_BYTES) {
+            return false;
+        }
+        const char* record = mapping.getData() + position;
+        uint32_t payloadSize, checksum;
+        memcpy(&payloadSize, record, sizeof(payloadSize));
+        memcpy(&checksum, record + 4, sizeof(checksum));
+        const char* payload = record + OrderJournal::RECORD_HEADER_BYTES;
+        if (size - position - OrderJournal::RECORD_HEADER_BYTES < payloadSize ||
+            !OrderJournal::decode(payload, payloadSize, order) ||
+            (verifyChecksum && crc32(payload, payloadSize) != checksum)) {
+            return false;
+        }
+        length = OrderJournal::RECORD_HEADER_BYTES + payloadSize;
+        return true;
+    }
+
+public:
+    // Constructor
+    JournalReader() : offset(0), damagedPassed(0) {}
+
+    // Map a journal; a missing or empty journal reads as having no records
+    void open(const string& path) {
+        mapping.open(path);
+        offset = 0;
+        damaged.clear();
+        damagedPassed = 0;
+    }
+
+    // Start reading from the first record again; damage found so far is remembered
+    void rewind() {
+        offset = 0;
+        damagedPassed = 0;
+    }
+
+    // Next record, or false at the end of the good data. Records already checked
+    // by an earlier pass can skip the checksum; such a pass steps over the damage
+    // the checked pass found and stops at any it did not.
+    bool next(JournalOrder& order, bool verifyChecksum = true) {
+        if (damagedPassed < damaged.size() && damaged[damagedPassed].offset == offset) {
+            offset += damaged[damagedPassed].length;
+            damagedPassed++;
+        }
+        size_t size = mapping.getSize();
+        size_t length;
+        if (offset >= size) {
+            return false;
+        }
+        if (readRecord(offset, order, verifyChecksum, length)) {
+            offset += length;
+            return true;
+        }
+        if (!verifyChecksum) {
+            return false;
+        }
+        for (size_t position = offset + 1; position < size && size - position >= OrderJournal::RECORD_HEADER_BYTES; position++) {
+            if (readRecord(position, order, true, length)) {
+                damaged.push_back(DamagedRange{offset, position - offset});
+                damagedPassed = damaged.size();
+                offset = position + length;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // True when reading stopped at a record cut short by the end of the file,
+    // i.e. everything from getValidBytes() on is a torn write
+    bool endsInTornRecord() const {
+        size_t size = mapping.getSize();
+        if (offset >= size) {
+            return false;
+        }
+        if (size - offset < OrderJournal::RECORD_HEADER_BYTES) {
+            return true;
+        }
+        uint32_t payloadSize;
+        memcpy(&payloadSize, mapping.getData() + offset, sizeof(payloadSize));
+        return size - offset - OrderJournal::RECORD_HEADER_BYTES < payloadSize;
+    }
+
+    // Getters
+    size_t getValidBytes() const { return offset; }
+    size_t getFileBytes() const { return mapping.getSize(); }
+    size_t getDamagedRangeCount() const { return damaged.size(); }
+    size_t getDamagedBytes() const {
+        size_t bytes = 0;
+        for (const DamagedRange& range : damaged) {
+            bytes += range.length;
+        }
+        return bytes;
+    }
+};
+
+// Hands out order IDs from blocks leased in a file. Before any ID of a block is
+// used, the end of the block is durably written to the file, so after a crash
+// IDs restart above everything handed out: there can be gaps, never duplicates.
+// Within a lease, allocation is a single atomic fetch_add.
+class OrderIdAllocator {
+private:
+    static const int BLOCK_SIZE = 1024;
+
+    string path;
+    atomic<int> next;
+    atomic<int> leaseEnd; // first ID not covered by the file
+    mutex leaseMutex;
+
+public:
+    // Constructor reading the lease file
+    explicit OrderIdAllocator(const string& _path) : path(_path), next(1), leaseEnd(1) {
+        ifstream idFile(path);
+        int stored = 0;
+        if (idFile >> stored && stored > 0) {
+            next.store(stored);
+            leaseEnd.store(stored);
+        } else {
+            cerr << "Warning: Could not load next order ID from file. Starting from 1." << endl;
+        }
+    }
+
+    // Never hand out an ID below floor (used after replaying the journal). A floor
+    // past the ID range leaves nothing to allocate.
+    void raiseFloor(int64_t floor) {
+        int clamped = static_cast<int>(min<int64_t>(floor, INT32_MAX));
+        lock_guard<mutex> lock(leaseMutex);
+        if (next.load() < clamped) {
+            next.store(clamped);
+            leaseEnd.store(max(leaseEnd.load(), clamped));
+        }
+    }
+
+    // Next unused ID; leases a new block when the current one runs out
+    int allocate() {
+        int id = next.fetch_add(1, memory_order_relaxed);
+        if (id <= 0 || id == INT32_MAX) {
+            next.store(INT32_MAX, memory_order_relaxed);
+            throw ArrayFullException("Order ID range");
+        }
+        if (id < leaseEnd.load(memory_order_acquire)) {
+            return id;
+        }
+
+        lock_guard<mutex> lock(leaseMutex);
+        int end = leaseEnd.load(memory_order_relaxed);
+        if (id >= end) {
+            // In 64 bits and clamped, so the lease never wraps or covers INT32_MAX
+            int newEnd = static_cast<int>(min<int64_t>(max<int64_t>(end, static_cast<int64_t>(id) + 1) + BLOCK_SIZE,
+                                                       INT32_MAX));
+            if (!replaceFileDurably(path, to_string(newEnd))) {
+                throw ECommerceException(ErrorCode::IoFailure, "Could not reserve order IDs in " + path + ".");
+            }
+            leaseEnd.store(newEnd, memory_order_release);
+        }
+        return id;
+    }
+
+    // Record the exact next ID on clean shutdown, so the unused part of the lease is not skipped
+    bool save() {
+        lock_guard<mutex> lock(leaseMutex);
+        if (!replaceFileDurably(path, to_string(next.load()))) {
+            return false;
+        }
+        leaseEnd.store(next.load());
+        return true;
+    }
+
+    // Get the ID the next allocation would return
+    int peek() const {
+        return next.load(memory_order_relaxed);
+    }
+};
+
+// Strategy Pattern for Payment Methods
+class PaymentStrategy {
+public:
+    virtual ~PaymentStrategy() = default;
+    virtual bool processPayment(Money amount) = 0;
+    virtual string getMethodName() const = 0;
+};
+
+// The built-in methods are final, so calls on the concrete type bind statically
+class CashPayment final : public PaymentStrategy {
+public:
+    static constexpr string_view NAME = "Cash";
+
+    bool processPayment(Money amount) override {
+        cout << "Processing cash payment of ₱" << amount << '\n';
+        return true;
+    }
+    
+    string getMethodName() const override {
+        return string(NAME);
+    }
+};
+
+class CardPayment final : public PaymentStrategy {
+public:
+    static constexpr string_view NAME = "Credit / Debit Card";
+
+    bool processPayment(Money amount) override {
+        cout << "Processing credit/debit card payment of ₱" << amount << '\n';
+        return true;
     }
     
     string getMethodName() const override {
-        return "Credit / Debit Card";
+        return string(NAME);
     }
 };
 
-class GCashPayment : public PaymentStrategy {
+class GCashPayment final : public PaymentStrategy {
 public:
-    bool processPayment(double amount) override {
-        cout << "Processing GCash payment of ₱" << fixed << setprecision(2) << amount << endl;
+    static constexpr string_view NAME = "GCash";
+
+    bool processPayment(Money amount) override {
+        cout << "Processing GCash payment of ₱" << amount << '\n';
         return true;
     }
     
     string getMethodName() const override {
-        return "GCash";
+        return string(NAME);
+    }
+};
+
+// Any other PaymentStrategy (e.g. a gateway plugged in at startup), called through
+// its vtable. Does not own the strategy.
+class ExternalPayment {
+private:
+    PaymentStrategy* strategy;
+
+public:
+    // Constructor
+    explicit ExternalPayment(PaymentStrategy& _strategy) : strategy(&_strategy) {}
+
+    bool processPayment(Money amount) { return strategy->processPayment(amount); }
+    string getMethodName() const { return strategy->getMethodName(); }
+};
+
+// Payment methods held by value: checkout dispatches with std::visit, so there is
+// no heap allocation and, for the built-in methods, no virtual call per order
+using PaymentMethod = variant<CashPayment, CardPayment, GCashPayment, ExternalPayment>;
+
+// Method name without going through the vtable where the type is known
+template <typename Strategy>
+string_view paymentMethodName(const Strategy&) { return Strategy::NAME; }
+inline string paymentMethodName(const PaymentStrategy& strategy) { return strategy.getMethodName(); }
+inline string paymentMethodName(const ExternalPayment& payment) { return payment.getMethodName(); }
+
+// Payment methods keyed by method ID ("cash", "card", ...). Stateless methods are
+// constructed once and shared by every checkout; stateful ones come from a fixed
+// pool and are lent to one checkout at a time. Register everything at startup,
+// before the first acquire().
+class PaymentRegistry {
+private:
+    struct Entry {
+        string id;
+        string name;
+        vector<unique_ptr<PaymentMethod>> instances;
+        bool pooled;
+        vector<PaymentMethod*> idle; // pooled instances not lent out
+        mutex idleMutex;
+        condition_variable returned;
+    };
+
+    vector<unique_ptr<Entry>> entries;
+
+    Entry& addEntry(string id, string name, bool pooled) {
+        for (const unique_ptr<Entry>& entry : entries) {
+            if (entry->id == id) {
+                throw InvalidInputException("Payment method '" + id + "' is already registered.");
+            }
+        }
+        entries.push_back(make_unique<Entry>());
+        Entry& entry = *entries.back();
+        entry.id = move(id);
+        entry.name = move(name);
+        entry.pooled = pooled;
+        return entry;
+    }
+
+public:
+    // A payment method on loan; a pooled instance goes back to its pool when the lease ends
+    class Lease {
+    private:
+        Entry* entry;
+        PaymentMethod* method;
+
+    public:
+        // Constructor
+        Lease(Entry* _entry, PaymentMethod* _method) : entry(_entry), method(_method) {}
+
+        Lease(Lease&& other) noexcept : entry(other.entry), method(other.method) {
+            other.entry = nullptr;
+        }
+        Lease& operator=(Lease&&) = delete;
+
+        // Destructor
+        ~Lease() {
+            if (entry != nullptr && entry->pooled) {
+                {
+                    lock_guard<mutex> lock(entry->idleMutex);
+                    entry->idle.push_back(method);
+                }
+                entry->returned.notify_one();
+            }
+        }
+
+        PaymentMethod& get() const { return *method; }
+        const string& getMethodId() const { return entry->id; }
+    };
+
+    // Constructor
+    PaymentRegistry() = default;
+
+    PaymentRegistry(const PaymentRegistry&) = delete;
+    PaymentRegistry& operator=(const PaymentRegistry&) = delete;
+
+    // Register a stateless method shared by all checkouts
+    void registerMethod(string id, PaymentMethod method) {
+        string name(visit([](const auto& strategy) { return string(paymentMethodName(strategy)); }, method));
+        Entry& entry = addEntry(move(id), move(name), false);
+        entry.instances.push_back(make_unique<PaymentMethod>(move(method)));
+    }
+
+    // Register a stateful method: poolSize instances made up front, each serving one checkout at a time
+    void registerPool(string id, size_t poolSize, const function<PaymentMethod()>& factory) {
+        if (poolSize == 0) {
+            throw InvalidInputException("Payment pool '" + id + "' needs at least one instance.");
+        }
+        PaymentMethod first = factory();
+        string name(visit([](const auto& strategy) { return string(paymentMethodName(strategy)); }, first));
+        Entry& entry = addEntry(move(id), move(name), true);
+        entry.instances.push_back(make_unique<PaymentMethod>(move(first)));
+        while (entry.instances.size() < poolSize) {
+            entry.instances.push_back(make_unique<PaymentMethod>(factory()));
+        }
+        for (const unique_ptr<PaymentMethod>& instance : entry.instances) {
+            entry.idle.push_back(instance.get());
+        }
+    }
+
+    // Cash, card and GCash under the IDs "cash", "card" and "gcash"
+    void registerBuiltIns() {
+        registerMethod("cash", CashPayment());
+        registerMethod("card", CardPayment());
+        registerMethod("gcash", GCashPayment());
+    }
+
+    // Borrow a method by ID, waiting for a pooled instance if all are lent out
+    Result<Lease> acquire(string_view id) {
+        for (const unique_ptr<Entry>& entry : entries) {
+            if (entry->id == id) {
+                return acquire(*entry);
+            }
+        }
+        return InvalidInputException("Unknown payment method '" + string(id) + "'.");
+    }
+
+    // Borrow the method at a registration position (0-based)
+    Lease acquireAt(size_t position) {
+        return acquire(*entries.at(position));
+    }
+
+    // Get registered method count
+    size_t size() const { return entries.size(); }
+
+    // Display name of the method at a registration position
+    const string& getName(size_t position) const { return entries.at(position)->name; }
+
+private:
+    Lease acquire(Entry& entry) {
+        if (!entry.pooled) {
+            return Lease(&entry, entry.instances.front().get());
+        }
+        unique_lock<mutex> lock(entry.idleMutex);
+        entry.returned.wait(lock, [&] { return !entry.idle.empty(); });
+        PaymentMethod* method = entry.idle.back();
+        entry.idle.pop_back();
+        return Lease(&entry, method);
     }
 };
 
-// Singleton Pattern for Payment Processor
-class PaymentProcessor {
-    private:
-        static PaymentProcessor* instance;
-        int nextOrderId;
-        Order orders[10];
-        int orderCount;
-    
-        // Private constructor for singleton
-        PaymentProcessor() : nextOrderId(1), orderCount(0) {
-            ifstream idFile("nextOrderId.txt");
-            if (idFile) {
-                idFile >> nextOrderId;
-                idFile.close();
-            } else {
-                cerr << "Warning: Could not load next order ID from file. Starting from 1." << endl;
+// Singleton Pattern for Payment Processor
+class PaymentProcessor {
+    private:
+        static atomic<PaymentProcessor*> instance;
+        static mutex instanceMutex;
+        static string dataPrefix; // prepended to the order ID and journal file names
+        OrderIdAllocator orderIds;
+        ShardedOrderStore orders;
+        shared_ptr<Catalog> orderedProducts; // products referenced by replayed orders
+        unique_ptr<AsyncOrderLog> orderLog; // opened only once recovery is done
+    
+        // Private constructor for singleton. The journal is recovered (and a torn tail
+        // cut off) before the log opens it for writing; on Windows an open writer
+        // would otherwise keep recovery from reading it at all.
+        PaymentProcessor()
+            : orderIds(dataPrefix + "nextOrderId.txt"), orderedProducts(make_shared<Catalog>()) {
+            recoverOrders(dataPrefix + "orders.journal");
+            orderLog.reset(new AsyncOrderLog(dataPrefix + "orders.journal"));
+        }
+
+        // Rebuild the order history from the journal. Damaged records are skipped and
+        // left in the file; only a record torn off by the end of the file is cut away.
+        void recoverOrders(const string& journalPath) {
+            size_t validBytes, fileBytes;
+            size_t damagedRanges, damagedBytes;
+            bool tornTail;
+            size_t skipped = 0;
+            int lastOrderId = 0;
+            {
+                JournalReader reader;
+                reader.open(journalPath);
+                JournalOrder record;
+
+                // First pass: collect the distinct products the orders refer to
+                ProductIndex productPositions;
+                productPositions.reserve(1024);
+                int32_t productCount = 0;
+                orderedProducts->resetOwned();
+                while (reader.next(record)) {
+                    for (const JournalLine& line : record.lines) {
+                        if (productPositions.find(line.productId) < 0 &&
+                            orderedProducts->addProduct(line.productId.chars, strnlen(line.productId.chars, ProductKey::WIDTH),
+                                                        line.productName.data(), line.productName.size(), line.unitPrice)) {
+                            productPositions.insert(line.productId, productCount++);
+                        }
+                    }
+                }
+                orderedProducts->finishOwned();
+                const vector<Product>& products = orderedProducts->getProducts();
+
+                // Second pass over the records the first pass verified
+                validBytes = reader.getValidBytes();
+                fileBytes = reader.getFileBytes();
+                damagedRanges = reader.getDamagedRangeCount();
+                damagedBytes = reader.getDamagedBytes();
+                tornTail = reader.endsInTornRecord();
+                reader.rewind();
+                while (reader.getValidBytes() < validBytes && reader.next(record, false)) {
+                    LineItems items;
+                    bool complete = true;
+                    for (const JournalLine& line : record.lines) {
+                        int32_t position = productPositions.find(line.productId);
+                        if (position < 0) {
+                            complete = false;
+                            break;
+                        }
+                        items.add(shared_ptr<Product>(orderedProducts, const_cast<Product*>(&products[position])),
+                                  line.unitPrice, line.quantity);
+                    }
+                    if (!complete || record.orderId <= 0 || orders.find(record.orderId) != nullptr) {
+                        skipped++;
+                        continue;
+                    }
+                    orders.emplace(record.orderId, move(items), string(record.paymentMethod));
+                    lastOrderId = max(lastOrderId, record.orderId);
+                }
+            }
+
+            if (skipped > 0) {
+                cerr << "Warning: Skipped " << skipped << " unusable order(s) in " << journalPath << "." << endl;
+            }
+            if (damagedRanges > 0) {
+                cerr << "Warning: Skipped " << damagedBytes << " damaged byte(s) in " << damagedRanges
+                     << " place(s) in " << journalPath << "; they are left in the file." << endl;
             }
+            if (validBytes < fileBytes && tornTail) {
+                cerr << "Warning: Truncating torn journal tail (" << fileBytes - validBytes
+                     << " bytes) in " << journalPath << "." << endl;
+                if (!truncateFile(journalPath, validBytes)) {
+                    cerr << "Warning: Could not truncate " << journalPath << "." << endl;
+                }
+            } else if (validBytes < fileBytes) {
+                cerr << "Warning: Ignoring a damaged last record (" << fileBytes - validBytes
+                     << " bytes) in " << journalPath << "; it is left in the file." << endl;
+            }
+            orderIds.raiseFloor(static_cast<int64_t>(lastOrderId) + 1);
         }
     
     public:
-        // Get singleton instance
+        // Get singleton instance; safe to call from any thread
         static PaymentProcessor* getInstance() {
-            if (instance == nullptr) {
-                instance = new PaymentProcessor();
+            PaymentProcessor* current = instance.load(memory_order_acquire);
+            if (current == nullptr) {
+                lock_guard<mutex> lock(instanceMutex);
+                current = instance.load(memory_order_relaxed);
+                if (current == nullptr) {
+                    current = new PaymentProcessor();
+                    instance.store(current, memory_order_release);
+                }
             }
-            return instance;
+            return current;
+        }
+
+        // Keep the order ID and journal files under another name, e.g. for benchmarks.
+        // Takes effect when the instance is next created.
+        static void setDataPrefix(const string& prefix) {
+            lock_guard<mutex> lock(instanceMutex);
+            dataPrefix = prefix;
+        }
+
+        // Destroy the singleton, saving state and draining the order log.
+        // Call once no other thread is using the instance.
+        static void destroyInstance() {
+            lock_guard<mutex> lock(instanceMutex);
+            delete instance.exchange(nullptr, memory_order_acq_rel);
         }
     
         // Save next order ID to file
         void saveNextOrderId() {
-            ofstream idFile("nextOrderId.txt");
-            if (!idFile) {
+            if (!orderIds.save()) {
                 cerr << "Warning: Could not save next order ID to file." << endl;
-                return;
             }
-            idFile << nextOrderId;
-            idFile.close();
         }
     
-        // Destructor to save next order ID
+        // Destructor to save next order ID; the order log then drains its queue
         ~PaymentProcessor() {
             saveNextOrderId();
         }
     
-        // Process payment and create order
-        Order processPayment(const ShoppingCart& cart, PaymentStrategy* paymentStrategy) {
-            double amount = cart.getTotalAmount();
-    
+        // Process payment, store the order and log it. The payment is a PaymentMethod&
+        // or a PaymentStrategy*. Safe to call concurrently for different carts.
+        template <typename Payment>
+        Result<const Order*> tryProcessPayment(ShoppingCart& cart, Payment&& payment) {
+            Result<const Order*> placed = tryPlaceOrder(cart, forward<Payment>(payment));
+            if (placed) {
+                logOrder(*placed.value());
+            }
+            return placed;
+        }
+
+        // Process payment, store the order and log it, or ECommerceException
+        template <typename Payment>
+        const Order& processPayment(ShoppingCart& cart, Payment&& payment) {
+            const Order& order = placeOrder(cart, forward<Payment>(payment));
+            logOrder(order);
+            return order;
+        }
+
+        // Process payment and move the cart's lines into a stored order, without logging it
+        const Order& placeOrder(ShoppingCart& cart, PaymentMethod& paymentMethod) {
+            return *visit([&](auto& strategy) { return placeOrderWith(cart, strategy, ThrowError()).value(); },
+                          paymentMethod);
+        }
+
+        const Order& placeOrder(ShoppingCart& cart, PaymentStrategy* paymentStrategy) {
+            return *placeOrderWith(cart, *paymentStrategy, ThrowError()).value();
+        }
+
+        Result<const Order*> tryPlaceOrder(ShoppingCart& cart, PaymentMethod& paymentMethod) {
+            return visit([&](auto& strategy) { return placeOrderWith(cart, strategy, ReturnError()); },
+                         paymentMethod);
+        }
+
+        Result<const Order*> tryPlaceOrder(ShoppingCart& cart, PaymentStrategy* paymentStrategy) {
+            return placeOrderWith(cart, *paymentStrategy, ReturnError());
+        }
+
+    private:
+        template <typename Strategy, typename OnError>
+        Result<const Order*> placeOrderWith(ShoppingCart& cart, Strategy& paymentStrategy, OnError onError) {
+            Money amount = cart.getTotalAmount();
+            auto method = paymentMethodName(paymentStrategy);
+
+            bool success;
             try {
-                bool success = paymentStrategy->processPayment(amount);
-    
-                if (orderCount >= 10) {
-                    throw ArrayFullException("Orders database");
-                }
-    
-                // Create new order
-                Order order(nextOrderId++, cart.getItems(), cart.getItemCount(), paymentStrategy->getMethodName());
-                orders[orderCount++] = order;
-    
-                // Log the order
-                logOrder(order);
-    
-                return order;
+                success = paymentStrategy.processPayment(amount);
             } catch (const exception& e) {
-                throw ECommerceException("Payment failed with method: " + paymentStrategy->getMethodName());
+                return onError(ECommerceException(ErrorCode::PaymentFailed, method).causedBy(e));
+            }
+            if (!success) {
+                return onError(ECommerceException(ErrorCode::PaymentDeclined, method));
             }
-        }
     
-        // Log order to file
-        void logOrder(const Order& order) {
+            // Create new order in place, taking the cart's lines and their reservations.
+            // OrderFailed always leaves the cart as it was, reservations still held,
+            // whether the order ID or the store slot could not be had.
+            const Order* stored;
             try {
-                ofstream logFile("orders.log", ios::app);
-                if (!logFile) {
-                    cerr << "Warning: Could not open log file." << endl;
-                    return;
+                int orderId = orderIds.allocate();
+                LineItems items = cart.takeItems();
+                try {
+                    stored = &orders.emplace(orderId, move(items), string(move(method)));
+                } catch (...) {
+                    cart.restoreItems(move(items));
+                    throw;
                 }
+            } catch (const exception& e) {
+                return onError(
+                    ECommerceException(ErrorCode::OrderFailed, paymentMethodName(paymentStrategy)).causedBy(e));
+            }
+            commitStock(stored->getItems());
     
-                logFile << "[LOG] -> Order ID: " << order.getOrderId() 
-                        << " has been successfully checked out and paid using " 
-                        << order.getPaymentMethod() << endl;
+            return stored;
+        }
+
+    public:
     
-                logFile.close();
-            } catch (const exception& e) {
-                cerr << "Warning: Failed to log order: " << e.what() << endl;
+        // The order's units are sold: drop them from the reserved counts
+        static void commitStock(const OrderLines& items) {
+            for (int i = 0; i < items.size(); i++) {
+                items.productAt(i)->commitStock(items[i].getQuantity());
             }
         }
+
+        // Queue the order's journal record for the writer thread
+        void logOrder(const Order& order) {
+            static thread_local string record;
+            OrderJournal::encode(order, record);
+            orderLog->append(record.data(), record.size());
+        }
+
+        // Get the order log, e.g. to change its durability mode
+        AsyncOrderLog& getOrderLog() {
+            return *orderLog;
+        }
     
         // Get orders
-        const Order* getOrders() const {
-            return orders;
+        vector<const Order*> getOrdersById() const {
+            return orders.getOrdersById();
+        }
+
+        // Find an order by ID, or nullptr
+        const Order* findOrder(int orderId) const {
+            return orders.find(orderId);
         }
     
         // Get order count
-        int getOrderCount() const {
-            return orderCount;
+        size_t getOrderCount() const {
+            return orders.size();
         }
     };
     
 // Initialize static instance pointer
-PaymentProcessor* PaymentProcessor::instance = nullptr;
+atomic<PaymentProcessor*> PaymentProcessor::instance{nullptr};
+mutex PaymentProcessor::instanceMutex;
+string PaymentProcessor::dataPrefix;
+
+// One shopper's session: a cart that may be used from several threads
+class Session {
+private:
+    string id;
+    mutable mutex lock;
+    ShoppingCart cart;
+
+public:
+    // Constructor
+    explicit Session(const string& _id) : id(_id) {}
+
+    // Run f on the cart while holding the session lock
+    template <typename F>
+    auto withCart(F f) -> decltype(f(cart)) {
+        lock_guard<mutex> guard(lock);
+        return f(cart);
+    }
+
+    // Getters
+    const string& getId() const { return id; }
+};
+
+// Many independent sessions keyed by session ID over one shared Inventory.
+// Sessions live in hash-sharded maps, and each cart has its own lock, so
+// sessions do not contend with each other; catalog lookups never lock.
+class SessionManager {
+private:
+    static const size_t SHARD_COUNT = 64;
+
+    struct alignas(64) Shard {
+        mutable mutex lock;
+        unordered_map<string, shared_ptr<Session>> sessions;
+    };
+
+    const Inventory& inventory;
+    Shard shards[SHARD_COUNT];
+    atomic<size_t> sessionCount;
+
+    Shard& shardFor(const string& sessionId) { return shards[hash<string>()(sessionId) % SHARD_COUNT]; }
+    const Shard& shardFor(const string& sessionId) const { return shards[hash<string>()(sessionId) % SHARD_COUNT]; }
+
+    // Existing session, or InvalidInputException for unknown IDs
+    shared_ptr<Session> requireSession(const string& sessionId) const {
+        shared_ptr<Session> session = findSession(sessionId);
+        if (!session) {
+            throw InvalidInputException("Unknown session '" + sessionId + "'.");
+        }
+        return session;
+    }
+
+public:
+    // Constructor
+    explicit SessionManager(const Inventory& _inventory) : inventory(_inventory), sessionCount(0) {}
+
+    // Get or create a session
+    shared_ptr<Session> openSession(const string& sessionId) {
+        Shard& shard = shardFor(sessionId);
+        lock_guard<mutex> lock(shard.lock);
+        shared_ptr<Session>& session = shard.sessions[sessionId];
+        if (!session) {
+            session = make_shared<Session>(sessionId);
+            sessionCount.fetch_add(1, memory_order_relaxed);
+        }
+        return session;
+    }
+
+    // Existing session, or nullptr
+    shared_ptr<Session> findSession(const string& sessionId) const {
+        const Shard& shard = shardFor(sessionId);
+        lock_guard<mutex> lock(shard.lock);
+        auto found = shard.sessions.find(sessionId);
+        return found == shard.sessions.end() ? nullptr : found->second;
+    }
+
+    // Forget a session and its cart; false if it did not exist
+    bool closeSession(const string& sessionId) {
+        Shard& shard = shardFor(sessionId);
+        lock_guard<mutex> lock(shard.lock);
+        if (shard.sessions.erase(sessionId) == 0) {
+            return false;
+        }
+        sessionCount.fetch_sub(1, memory_order_relaxed);
+        return true;
+    }
+
+    // Add a product to a session's cart, opening the session if needed
+    Result<void> tryAddToCart(const string& sessionId, string_view productId, int quantity) {
+        Result<shared_ptr<Product>> product = inventory.tryFindProduct(productId);
+        if (!product) {
+            return product.error();
+        }
+        return openSession(sessionId)->withCart([&](ShoppingCart& cart) {
+            return cart.tryAddItem(move(product.value()), quantity);
+        });
+    }
+
+    void addToCart(const string& sessionId, const string& productId, int quantity) {
+        shared_ptr<Product> product = inventory.findProduct(productId);
+        openSession(sessionId)->withCart([&](ShoppingCart& cart) { cart.addItem(move(product), quantity); });
+    }
+
+    // Change the quantity of a product in a session's cart
+    void updateQuantity(const string& sessionId, const string& productId, int quantity) {
+        shared_ptr<Product> product = inventory.findProduct(productId);
+        requireSession(sessionId)->withCart([&](ShoppingCart& cart) { cart.updateQuantity(product.get(), quantity); });
+    }
+
+    // Remove a product from a session's cart
+    void removeFromCart(const string& sessionId, const string& productId) {
+        shared_ptr<Product> product = inventory.findProduct(productId);
+        requireSession(sessionId)->withCart([&](ShoppingCart& cart) { cart.removeItem(product.get()); });
+    }
+
+    // Running total of a session's cart
+    Money getCartTotal(const string& sessionId) const {
+        return requireSession(sessionId)->withCart([](ShoppingCart& cart) { return cart.getTotalAmount(); });
+    }
+
+    // Pay for a session's cart with a PaymentMethod& or PaymentStrategy* and turn it into an order
+    template <typename Payment>
+    Result<const Order*> tryCheckout(const string& sessionId, Payment&& payment) {
+        shared_ptr<Session> session = findSession(sessionId);
+        if (!session) {
+            return InvalidInputException("Unknown session '" + sessionId + "'.");
+        }
+        return session->withCart([&](ShoppingCart& cart) -> Result<const Order*> {
+            if (cart.isEmpty()) {
+                return InvalidInputException("Cart is empty.");
+            }
+            return PaymentProcessor::getInstance()->tryProcessPayment(cart, forward<Payment>(payment));
+        });
+    }
+
+    template <typename Payment>
+    const Order& checkout(const string& sessionId, Payment&& payment) {
+        shared_ptr<Session> session = findSession(sessionId);
+        if (!session) {
+            throw InvalidInputException("Unknown session '" + sessionId + "'.");
+        }
+        return session->withCart([&](ShoppingCart& cart) -> const Order& {
+            if (cart.isEmpty()) {
+                throw InvalidInputException("Cart is empty.");
+            }
+            return PaymentProcessor::getInstance()->processPayment(cart, forward<Payment>(payment));
+        });
+    }
+
+    // Get session count
+    size_t getSessionCount() const {
+        return sessionCount.load(memory_order_relaxed);
+    }
+};
 
 // E-commerce System class
 class ECommerceSystem {
 private:
     Inventory inventory;
-    ShoppingCart cart;
+    SessionManager sessions;
+    shared_ptr<Session> session; // the console shopper's session
+    PaymentRegistry payments;
     
     // Input validation helper
     int getIntInput(const string& prompt) {
@@ -499,26 +3496,20 @@ private:
         return ' ';
     }
     
-    PaymentStrategy* selectPaymentStrategy() {
-        int choice;
-        bool validChoice = false;
-        
-        while (!validChoice) {
+    PaymentRegistry::Lease selectPaymentMethod() {
+        size_t count = payments.size();
+        while (true) {
             cout << "\nSelect payment method:" << endl;
-            cout << "1. Cash" << endl;
-            cout << "2. Credit / Debit Card" << endl;
-            cout << "3. GCash" << endl;
-    
-            choice = getIntInput("Enter your choice (1-3): ");
-            switch (choice) {
-                case 1: return new CashPayment();
-                case 2: return new CardPayment();
-                case 3: return new GCashPayment();
-                default:
-                    cout << "Invalid choice. Please enter a number between 1 and 3." << endl;
+            for (size_t i = 0; i < count; i++) {
+                cout << i + 1 << ". " << payments.getName(i) << endl;
+            }
+    
+            int choice = getIntInput("Enter your choice (1-" + to_string(count) + "): ");
+            if (choice >= 1 && static_cast<size_t>(choice) <= count) {
+                return payments.acquireAt(choice - 1);
             }
+            cout << "Invalid choice. Please enter a number between 1 and " << count << "." << endl;
         }
-        return 0;
     }
     
     void viewProducts() {
@@ -532,7 +3523,7 @@ private:
                 auto product = inventory.findProduct(productId);
                 int quantity = getIntInput("Enter quantity: ");
                 
-                cart.addItem(product, quantity);
+                session->withCart([&](ShoppingCart& cart) { cart.addItem(product, quantity); });
                 cout << "Product added successfully!" << endl;
                 
                 char addMore = getCharInput("Do you want to add another product? (Y/N): ");
@@ -550,12 +3541,12 @@ private:
     }
     
     void viewCart() {
-        if (cart.isEmpty()) {
+        if (session->withCart([](ShoppingCart& cart) { return cart.isEmpty(); })) {
             cout << "Your shopping cart is empty. Please add products before checking out." << endl;
             return;
         }
         
-        cart.display();
+        session->withCart([](ShoppingCart& cart) { cart.display(); });
         
         char checkout = getCharInput("\nDo you want to check out all the products? (Y/N): ");
         if (toupper(checkout) != 'Y') {
@@ -563,13 +3554,10 @@ private:
         }
         
         try {
-            PaymentStrategy* paymentStrategy = selectPaymentStrategy();
-            Order order = PaymentProcessor::getInstance()->processPayment(cart, paymentStrategy);
+            PaymentRegistry::Lease paymentMethod = selectPaymentMethod();
+            sessions.checkout(session->getId(), paymentMethod.get());
             
             cout << "\nYou have successfully checked out the products!" << endl;
-            
-            delete paymentStrategy; // Clean up
-            cart.clear(); // Clear cart after successful checkout
         } catch (const ECommerceException& e) {
             cout << "Error: " << e.what() << endl;
         }
@@ -577,7 +3565,7 @@ private:
     
     void viewOrders() {
         PaymentProcessor* processor = PaymentProcessor::getInstance();
-        int orderCount = processor->getOrderCount();
+        size_t orderCount = processor->getOrderCount();
         
         if (orderCount == 0) {
             cout << "No orders to display." << endl;
@@ -585,14 +3573,22 @@ private:
         }
         
         cout << "\n----- Order History -----" << endl;
-        const Order* orders = processor->getOrders();
-        
-        for (int i = 0; i < orderCount; i++) {
-            orders[i].display();
+        for (const Order* order : processor->getOrdersById()) {
+            order->display();
         }
     }
     
 public:
+    // Constructor
+    ECommerceSystem() : sessions(inventory), session(sessions.openSession("console")) {
+        payments.registerBuiltIns();
+    }
+
+    // Payment methods offered at checkout; plug in more before run()
+    PaymentRegistry& getPaymentRegistry() {
+        return payments;
+    }
+
     void run() {
         cout << "===== Welcome to the Daniboy's E-commerce System =====" << endl;
         bool running = true;
@@ -635,12 +3631,649 @@ public:
     }
 };
 
-int main() {
+// Microbenchmark: columnar line totals versus the old shared_ptr<Product> pointer chase
+void benchmarkLineTotals() {
+    // Mirrors the original layout: heap Product with double price behind a shared_ptr
+    struct LegacyProduct {
+        string id;
+        string name;
+        double price;
+    };
+    struct LegacyLine {
+        shared_ptr<LegacyProduct> product;
+        int quantity;
+    };
+
+    const size_t sizes[] = {10, 1000, 100000};
+    cout << left << setw(12) << "Lines" << setw(22) << "Pointer chase (ns)"
+         << setw(22) << "Columnar SIMD (ns)" << "Speedup" << endl;
+
+    for (size_t lines : sizes) {
+        vector<LegacyLine> legacy;
+        vector<int64_t> prices;
+        vector<int32_t> quantities;
+        for (size_t i = 0; i < lines; i++) {
+            double price = 1.0 + static_cast<double>(i % 997) * 0.25;
+            int quantity = 1 + static_cast<int>(i % 7);
+            legacy.push_back({make_shared<LegacyProduct>(LegacyProduct{"SKU" + to_string(i), "Product " + to_string(i), price}), quantity});
+            prices.push_back(100 + static_cast<int64_t>(i % 997) * 25);
+            quantities.push_back(quantity);
+        }
+
+        size_t iterations = max<size_t>(1, 20000000 / lines);
+        volatile double sink = 0;
+
+        auto start = chrono::steady_clock::now();
+        for (size_t n = 0; n < iterations; n++) {
+            double total = 0;
+            for (const LegacyLine& line : legacy) {
+                total += line.product->price * line.quantity;
+            }
+            sink = sink + total;
+        }
+        auto middle = chrono::steady_clock::now();
+        for (size_t n = 0; n < iterations; n++) {
+            sink = sink + static_cast<double>(sumLineTotals(prices.data(), quantities.data(), lines));
+        }
+        auto end = chrono::steady_clock::now();
+
+        double legacyNs = chrono::duration<double, nano>(middle - start).count() / iterations;
+        double columnarNs = chrono::duration<double, nano>(end - middle).count() / iterations;
+        cout << left << setw(12) << lines
+             << setw(22) << fixed << setprecision(1) << legacyNs
+             << setw(22) << columnarNs
+             << setprecision(2) << legacyNs / columnarNs << "x" << endl;
+    }
+}
+
+// Print every order in a journal
+int dumpJournal(const string& path) {
+    JournalReader reader;
+    reader.open(path);
+    JournalOrder order;
+    size_t count = 0;
+    while (reader.next(order)) {
+        count++;
+        cout << "\nOrder ID: " << order.orderId << endl;
+        cout << "Total Amount: " << order.totalAmount << endl;
+        cout << "Payment Method: " << order.paymentMethod << endl;
+        cout << left << setw(15) << "Product ID" 
+             << setw(20) << "Name" 
+             << setw(10) << "Price" 
+             << setw(10) << "Quantity" << endl;
+        for (const JournalLine& line : order.lines) {
+            cout << left << setw(15) << string_view(line.productId.chars, strnlen(line.productId.chars, ProductKey::WIDTH))
+                 << setw(20) << line.productName
+                 << setw(10) << line.unitPrice
+                 << setw(10) << line.quantity << endl;
+        }
+    }
+    size_t badBytes = reader.getDamagedBytes() + (reader.getFileBytes() - reader.getValidBytes());
+    cout << "\n" << count << " order(s), " << reader.getFileBytes() - badBytes << " of " << reader.getFileBytes() << " bytes valid";
+    if (reader.getDamagedRangeCount() > 0) {
+        cout << ", " << reader.getDamagedRangeCount() << " damaged range(s) skipped";
+    }
+    cout << "." << endl;
+    return badBytes == 0 ? 0 : 1;
+}
+
+// Microbenchmark: cost of a product lookup miss with the old string-holding
+// exceptions versus the fixed-capacity ones
+void benchmarkExceptions() {
+    // Mirrors the original hierarchy: every exception builds and stores a std::string
+    struct LegacyECommerceException : public exception {
+        string message;
+        LegacyECommerceException(const string& msg) : message(msg) {}
+        const char* what() const noexcept override { return message.c_str(); }
+    };
+    struct LegacyProductNotFoundException : public LegacyECommerceException {
+        LegacyProductNotFoundException(const string& id)
+            : LegacyECommerceException("Product with ID '" + id + "' not found!") {}
+    };
+
+    const size_t iterations = 1000000;
+    const string id = "NOSUCHSKU12345"; // long enough to defeat the small-string buffer
+    Inventory inventory;
+    volatile size_t sink = 0;
+
+    auto time = [&](auto&& body) {
+        auto start = chrono::steady_clock::now();
+        for (size_t n = 0; n < iterations; n++) {
+            body();
+        }
+        return chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / iterations;
+    };
+
+    double legacyThrow = time([&] {
+        try { throw LegacyProductNotFoundException(id); }
+        catch (const LegacyECommerceException& e) { sink = sink + 1; }
+    });
+    double legacyWhat = time([&] {
+        try { throw LegacyProductNotFoundException(id); }
+        catch (const LegacyECommerceException& e) { sink = sink + strlen(e.what()); }
+    });
+    double fixedThrow = time([&] {
+        try { throw ProductNotFoundException(id); }
+        catch (const ECommerceException& e) { sink = sink + static_cast<size_t>(e.getCode()); }
+    });
+    double fixedWhat = time([&] {
+        try { throw ProductNotFoundException(id); }
+        catch (const ECommerceException& e) { sink = sink + strlen(e.what()); }
+    });
+    double lookupMiss = time([&] {
+        try { inventory.findProduct(id); }
+        catch (const ECommerceException& e) { sink = sink + static_cast<size_t>(e.getCode()); }
+    });
+    double tryLookupMiss = time([&] {
+        Result<shared_ptr<Product>> found = inventory.tryFindProduct(id);
+        sink = sink + static_cast<size_t>(found ? ErrorCode::General : found.error().getCode());
+    });
+
+    cout << left << setw(44) << "Miss path (ns per miss)" << setw(14) << "Catch only" << "Catch + what()" << endl;
+    cout << setw(44) << "Legacy string exception" << setw(14) << fixed << setprecision(1) << legacyThrow << legacyWhat << endl;
+    cout << setw(44) << "Fixed-capacity exception" << setw(14) << fixedThrow << fixedWhat << endl;
+    cout << setw(44) << "Inventory::findProduct miss" << lookupMiss << endl;
+    cout << setw(44) << "Inventory::tryFindProduct miss (no throw)" << tryLookupMiss << endl;
+    cout << "\nException object size: legacy " << sizeof(LegacyProductNotFoundException)
+         << " bytes + heap string, fixed " << sizeof(ProductNotFoundException) << " bytes" << endl;
+}
+
+// Stream buffer that discards everything written to it
+class NullBuffer : public streambuf {
+protected:
+    int overflow(int c) override { return traits_type::not_eof(c); }
+    streamsize xsputn(const char*, streamsize count) override { return count; }
+};
+
+// Microbenchmark: payment dispatch the old way (a new strategy per checkout behind a
+// virtual call) versus a PaymentMethod variant held by value and dispatched with visit.
+// Dispatch is timed on the method name alone; formatting the receipt costs more than
+// either dispatch, so the full processPayment call is reported separately.
+void benchmarkPayment() {
+    const size_t iterations = 5000000;
+    const Money amount = Money::fromCentavos(12345);
+    volatile size_t sink = 0;
+    uint64_t seed = 0x9E3779B97F4A7C15ull;
+    auto choose = [&seed] {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        return static_cast<int>(seed % 3);
+    };
+    auto newStrategy = [&choose]() -> PaymentStrategy* {
+        switch (choose()) {
+            case 0: return new CashPayment();
+            case 1: return new CardPayment();
+            default: return new GCashPayment();
+        }
+    };
+    auto chooseMethod = [&choose](PaymentMethod& method) {
+        switch (choose()) {
+            case 0: method.emplace<CashPayment>(); break;
+            case 1: method.emplace<CardPayment>(); break;
+            default: method.emplace<GCashPayment>(); break;
+        }
+    };
+    auto time = [&](auto&& body) {
+        auto start = chrono::steady_clock::now();
+        for (size_t n = 0; n < iterations; n++) {
+            body();
+        }
+        return chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / iterations;
+    };
+
+    double legacyNs = time([&] {
+        PaymentStrategy* strategy = newStrategy();
+        string name = strategy->getMethodName();
+        sink = sink + name.size();
+        delete strategy;
+    });
+    double variantNs = time([&] {
+        PaymentMethod method;
+        chooseMethod(method);
+        sink = sink + visit([](auto& strategy) { return paymentMethodName(strategy).size(); }, method);
+    });
+
+    // Receipts go nowhere, so the numbers show the formatting rather than console output
+    NullBuffer nullBuffer;
+    streambuf* console = cout.rdbuf(&nullBuffer);
+    double legacyPaidNs = time([&] {
+        PaymentStrategy* strategy = newStrategy();
+        bool paid = strategy->processPayment(amount);
+        string name = strategy->getMethodName();
+        sink = sink + paid + name.size();
+        delete strategy;
+    });
+    double variantPaidNs = time([&] {
+        PaymentMethod method;
+        chooseMethod(method);
+        sink = sink + visit([&](auto& strategy) {
+            return strategy.processPayment(amount) + paymentMethodName(strategy).size();
+        }, method);
+    });
+    cout.rdbuf(console);
+
+    cout << left << setw(44) << "Payment dispatch (ns per order)" << setw(14) << "Name only" << "With receipt" << endl;
+    cout << setw(44) << "new + virtual call + getMethodName()" << setw(14) << fixed << setprecision(1) << legacyNs
+         << legacyPaidNs << endl;
+    cout << setw(44) << "variant + visit + NAME" << setw(14) << variantNs << variantPaidNs << endl;
+    cout << "\nPer order the variant saves the strategy allocation, the name string for names past the"
+         << "\nsmall-string buffer, and an indirect call; " << setprecision(1)
+         << legacyNs - variantNs << " ns of dispatch here (" << setprecision(2) << legacyNs / variantNs << "x)."
+         << endl;
+}
+
+// Latency samples of one checkout pipeline stage, in nanoseconds
+struct StageSamples {
+    vector<uint32_t> nanos;
+
+    void record(chrono::steady_clock::time_point start, chrono::steady_clock::time_point end) {
+        int64_t elapsed = chrono::duration_cast<chrono::nanoseconds>(end - start).count();
+        nanos.push_back(static_cast<uint32_t>(min<int64_t>(elapsed, UINT32_MAX)));
+    }
+
+    void append(const StageSamples& other) {
+        nanos.insert(nanos.end(), other.nanos.begin(), other.nanos.end());
+    }
+};
+
+// Print count, per-thread throughput and latency percentiles of one stage
+void printStage(const char* name, StageSamples& samples) {
+    vector<uint32_t>& nanos = samples.nanos;
+    if (nanos.empty()) {
+        return;
+    }
+    sort(nanos.begin(), nanos.end());
+    double totalNs = 0;
+    for (uint32_t n : nanos) {
+        totalNs += n;
+    }
+    auto percentile = [&](double p) { return nanos[static_cast<size_t>(p * (nanos.size() - 1))] / 1000.0; };
+    cout << left << setw(14) << name
+         << setw(12) << nanos.size()
+         << setw(16) << fixed << setprecision(0) << (totalNs > 0 ? nanos.size() / (totalNs * 1e-9) : 0.0)
+         << setw(12) << setprecision(2) << percentile(0.50)
+         << setw(12) << percentile(0.99)
+         << setw(12) << percentile(0.999) << endl;
+}
+
+// Load generator for findProduct -> addItem -> placeOrder -> logOrder. Options are
+// key=value: orders, products, lines (per cart), threads, mix (cash:card:gcash weights).
+// Uses its own catalog, journal and order ID files, which are removed afterwards.
+int benchmarkCheckout(int argc, char* argv[]) {
+    size_t orderCount = 1000000;
+    size_t productCount = 10000;
+    size_t linesPerCart = 5;
+    size_t threadCount = 1;
+    unsigned mix[3] = {1, 1, 1};
+    for (int i = 0; i < argc; i++) {
+        string option(argv[i]);
+        size_t equals = option.find('=');
+        string key = option.substr(0, equals);
+        string value = equals == string::npos ? "" : option.substr(equals + 1);
+        char* end = nullptr;
+        unsigned long long number = strtoull(value.c_str(), &end, 10);
+        bool isNumber = !value.empty() && *end == '\0' && number > 0;
+        if (key == "orders" && isNumber) {
+            orderCount = number;
+        } else if (key == "products" && isNumber && number <= 1000000000) {
+            productCount = number;
+        } else if (key == "lines" && isNumber && number <= 10000) {
+            linesPerCart = number;
+        } else if (key == "threads" && isNumber && number <= 256) {
+            threadCount = number;
+        } else if (key == "mix" && sscanf(value.c_str(), "%u:%u:%u", &mix[0], &mix[1], &mix[2]) == 3 &&
+                   mix[0] + mix[1] + mix[2] > 0) {
+        } else {
+            cerr << "Error: Bad option '" << option << "'. Use orders=N products=N lines=N threads=N mix=C:D:G." << endl;
+            return 1;
+        }
+    }
+
+    // Synthetic catalog with counted stock large enough never to run out
+    const string catalogPath = "bench-catalog.txt";
+    const string prefix = "bench-";
+    {
+        ofstream catalogFile(catalogPath, ios::trunc);
+        char row[96];
+        for (size_t i = 0; i < productCount; i++) {
+            int64_t centavos = 100 + static_cast<int64_t>(i % 997) * 25;
+            int length = snprintf(row, sizeof(row), "SKU%zu,Product %zu,%lld.%02lld,1000000000\n", i, i,
+                                  static_cast<long long>(centavos / 100), static_cast<long long>(centavos % 100));
+            catalogFile.write(row, length);
+        }
+        if (!catalogFile) {
+            cerr << "Error: Could not write " << catalogPath << "." << endl;
+            return 1;
+        }
+    }
+    remove((prefix + "orders.journal").c_str());
+    remove((prefix + "nextOrderId.txt").c_str());
+    PaymentProcessor::setDataPrefix(prefix);
+    PaymentProcessor* processor = PaymentProcessor::getInstance();
+    Inventory inventory(catalogPath);
+
+    vector<string> productIds;
+    productIds.reserve(productCount);
+    for (size_t i = 0; i < productCount; i++) {
+        productIds.push_back("SKU" + to_string(i));
+    }
+
+    cout << "Checkout benchmark: " << orderCount << " orders, " << productCount << " products, "
+         << linesPerCart << " line(s) per cart, " << threadCount << " thread(s), mix "
+         << mix[0] << ":" << mix[1] << ":" << mix[2] << " (cash:card:gcash)" << endl;
+
+    // Receipts would otherwise dominate the payment stage
+    NullBuffer nullBuffer;
+    streambuf* console = cout.rdbuf(&nullBuffer);
+
+    vector<StageSamples> find(threadCount), add(threadCount), place(threadCount), log(threadCount);
+    atomic<size_t> failures(0);
+    auto start = chrono::steady_clock::now();
+    vector<thread> workers;
+    for (size_t t = 0; t < threadCount; t++) {
+        workers.emplace_back([&, t] {
+            size_t orders = orderCount / threadCount + (t < orderCount % threadCount ? 1 : 0);
+            find[t].nanos.reserve(orders * linesPerCart);
+            add[t].nanos.reserve(orders * linesPerCart);
+            place[t].nanos.reserve(orders);
+            log[t].nanos.reserve(orders);
+            PaymentMethod methods[3] = {CashPayment(), CardPayment(), GCashPayment()};
+            unsigned mixTotal = mix[0] + mix[1] + mix[2];
+            uint64_t seed = 0x9E3779B97F4A7C15ull * (t + 1);
+            auto random = [&seed] {
+                seed ^= seed << 13;
+                seed ^= seed >> 7;
+                seed ^= seed << 17;
+                return seed;
+            };
+
+            for (size_t n = 0; n < orders; n++) {
+                try {
+                    ShoppingCart cart;
+                    for (size_t line = 0; line < linesPerCart; line++) {
+                        const string& productId = productIds[random() % productCount];
+                        int quantity = 1 + static_cast<int>(random() % 3);
+                        auto t0 = chrono::steady_clock::now();
+                        shared_ptr<Product> product = inventory.findProduct(productId);
+                        auto t1 = chrono::steady_clock::now();
+                        cart.addItem(move(product), quantity);
+                        auto t2 = chrono::steady_clock::now();
+                        find[t].record(t0, t1);
+                        add[t].record(t1, t2);
+                    }
+
+                    unsigned pick = static_cast<unsigned>(random() % mixTotal);
+                    PaymentMethod& method = methods[pick < mix[0] ? 0 : pick < mix[0] + mix[1] ? 1 : 2];
+                    auto t3 = chrono::steady_clock::now();
+                    const Order& order = processor->placeOrder(cart, method);
+                    auto t4 = chrono::steady_clock::now();
+                    processor->logOrder(order);
+                    auto t5 = chrono::steady_clock::now();
+                    place[t].record(t3, t4);
+                    log[t].record(t4, t5);
+                } catch (const exception&) {
+                    failures.fetch_add(1, memory_order_relaxed);
+                }
+            }
+        });
+    }
+    for (thread& worker : workers) {
+        worker.join();
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout.rdbuf(console);
+
+    // Drain the order log and save the order ID lease
+    auto drainStart = chrono::steady_clock::now();
+    PaymentProcessor::destroyInstance();
+    double drainSeconds = chrono::duration<double>(chrono::steady_clock::now() - drainStart).count();
+
+    for (size_t t = 1; t < threadCount; t++) {
+        find[0].append(find[t]);
+        add[0].append(add[t]);
+        place[0].append(place[t]);
+        log[0].append(log[t]);
+    }
+    cout << "\n" << left << setw(14) << "Stage" << setw(12) << "Ops" << setw(16) << "Ops/s/thread"
+         << setw(12) << "p50 (us)" << setw(12) << "p99 (us)" << setw(12) << "p999 (us)" << endl;
+    printStage("findProduct", find[0]);
+    printStage("addItem", add[0]);
+    printStage("placeOrder", place[0]);
+    printStage("logOrder", log[0]);
+
+    size_t completed = place[0].nanos.size();
+    cout << "\n" << completed << " checkout(s) in " << fixed << setprecision(3) << seconds << " s ("
+         << setprecision(0) << completed / seconds << " checkouts/s), "
+         << failures.load() << " failure(s); log drain " << setprecision(3) << drainSeconds << " s" << endl;
+
+    remove(catalogPath.c_str());
+    remove((prefix + "orders.journal").c_str());
+    remove((prefix + "nextOrderId.txt").c_str());
+    PaymentProcessor::setDataPrefix("");
+    return failures.load() == 0 ? 0 : 1;
+}
+
+// Split the next whitespace-separated token off the front of a line
+string_view nextToken(string_view& line) {
+    size_t begin = line.find_first_not_of(" \t");
+    if (begin == string_view::npos) {
+        line = string_view();
+        return string_view();
+    }
+    size_t end = line.find_first_of(" \t", begin);
+    if (end == string_view::npos) {
+        end = line.size();
+    }
+    string_view token = line.substr(begin, end - begin);
+    line.remove_prefix(end);
+    return token;
+}
+
+// Parse a positive quantity, or InvalidInputException
+int parseQuantity(string_view token) {
+    int64_t value = 0;
+    for (char c : token) {
+        if (!isdigit(static_cast<unsigned char>(c)) || (value = value * 10 + (c - '0')) > INT32_MAX) {
+            throw InvalidInputException("Quantity must be a positive whole number.");
+        }
+    }
+    if (token.empty() || value == 0) {
+        throw InvalidInputException("Quantity must be a positive whole number.");
+    }
+    return static_cast<int>(value);
+}
+
+// Run a script of cart commands without prompts, one command per line:
+//   add <session> <productId> <quantity>
+//   update <session> <productId> <quantity>
+//   remove <session> <productId>
+//   clear <session>
+//   checkout <session> <payment method ID, e.g. cash|card|gcash>
+//   close <session>
+// Blank lines and lines starting with '#' are skipped. Failed commands are
+// reported with their line number and the script carries on. Orders go to the
+// order ID and journal files named with dataPrefix, never the live ones.
+int runBatch(const string& scriptPath, const string& catalogPath, const string& dataPrefix) {
+    ifstream script(scriptPath, ios::binary | ios::ate);
+    if (!script) {
+        cerr << "Error: Could not open " << scriptPath << "." << endl;
+        return 1;
+    }
+    streamsize size = script.tellg();
+    string buffer(static_cast<size_t>(size > 0 ? size : 0), '\0');
+    script.seekg(0);
+    if (!script.read(&buffer[0], size)) {
+        cerr << "Error: Could not read " << scriptPath << "." << endl;
+        return 1;
+    }
+    if (dataPrefix.empty()) {
+        cerr << "Error: The batch data prefix must not be empty." << endl;
+        return 1;
+    }
+    PaymentProcessor::setDataPrefix(dataPrefix);
+
+    Inventory inventory = catalogPath.empty() ? Inventory() : Inventory(catalogPath);
+    SessionManager sessions(inventory);
+    PaymentRegistry payments;
+    payments.registerBuiltIns();
+
+    ios::sync_with_stdio(false);
+    size_t commands = 0;
+    size_t orders = 0;
+    size_t failures = 0;
+    size_t lineNumber = 0;
+    auto start = chrono::steady_clock::now();
+
+    string_view rest(buffer);
+    while (!rest.empty()) {
+        size_t lineEnd = rest.find('\n');
+        string_view line = rest.substr(0, lineEnd);
+        rest.remove_prefix(lineEnd == string_view::npos ? rest.size() : lineEnd + 1);
+        lineNumber++;
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+
+        string_view command = nextToken(line);
+        if (command.empty() || command[0] == '#') {
+            continue;
+        }
+        commands++;
+        try {
+            string sessionId(nextToken(line));
+            if (sessionId.empty()) {
+                throw InvalidInputException("Missing session ID.");
+            }
+            if (command == "add" || command == "update") {
+                string productId(nextToken(line));
+                int quantity = parseQuantity(nextToken(line));
+                if (command == "add") {
+                    Result<void> added = sessions.tryAddToCart(sessionId, productId, quantity);
+                    if (!added) {
+                        failures++;
+                        cerr << scriptPath << ":" << lineNumber << ": " << added.error().what() << '\n';
+                    }
+                } else {
+                    sessions.updateQuantity(sessionId, productId, quantity);
+                }
+            } else if (command == "remove") {
+                sessions.removeFromCart(sessionId, string(nextToken(line)));
+            } else if (command == "clear") {
+                shared_ptr<Session> session = sessions.findSession(sessionId);
+                if (session) {
+                    session->withCart([](ShoppingCart& cart) { cart.clear(); });
+                }
+            } else if (command == "checkout") {
+                Result<PaymentRegistry::Lease> paymentMethod = payments.acquire(nextToken(line));
+                if (!paymentMethod) {
+                    paymentMethod.error().raise();
+                }
+                Result<const Order*> checkedOut = sessions.tryCheckout(sessionId, paymentMethod.value().get());
+                if (checkedOut) {
+                    orders++;
+                } else {
+                    failures++;
+                    cerr << scriptPath << ":" << lineNumber << ": " << checkedOut.error().what() << '\n';
+                }
+            } else if (command == "close") {
+                sessions.closeSession(sessionId);
+            } else {
+                throw InvalidInputException("Unknown command '" + string(command) + "'.");
+            }
+        } catch (const ECommerceException& e) {
+            failures++;
+            cerr << scriptPath << ":" << lineNumber << ": " << e.what() << '\n';
+        }
+    }
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout << "\nBatch complete: " << commands << " command(s), " << orders << " order(s), "
+         << failures << " failure(s) in " << fixed << setprecision(3) << seconds << " s";
+    if (seconds > 0) {
+        cout << " (" << setprecision(0) << commands / seconds << " commands/s)";
+    }
+    cout << endl;
+    return failures == 0 ? 0 : 1;
+}
+
+// Rewrite a journal in the legacy orders.log text format
+int convertJournalToText(const string& journalPath, const string& textPath) {
+    ofstream out(textPath, ios::trunc);
+    if (!out) {
+        cerr << "Error: Could not open " << textPath << "." << endl;
+        return 1;
+    }
+    JournalReader reader;
+    reader.open(journalPath);
+    JournalOrder order;
+    while (reader.next(order)) {
+        out << "[LOG] -> Order ID: " << order.orderId 
+            << " has been successfully checked out and paid using " 
+            << order.paymentMethod << '\n';
+    }
+    if (reader.getDamagedRangeCount() > 0) {
+        cerr << "Warning: Skipped " << reader.getDamagedBytes() << " damaged byte(s) in "
+             << reader.getDamagedRangeCount() << " place(s)." << endl;
+    }
+    if (reader.getValidBytes() != reader.getFileBytes()) {
+        cerr << "Warning: Stopped at a damaged record at byte " << reader.getValidBytes() << "." << endl;
+    }
+    return out ? 0 : 1;
+}
+
+int main(int argc, char* argv[]) {
+    // Convert a text catalog into the memory-mappable binary format
+    if (argc == 4 && string(argv[1]) == "--build-catalog") {
+        Catalog catalog;
+        if (!catalog.loadText(argv[2]) || !catalog.writeBinary(argv[3])) {
+            cerr << "Error: Could not convert " << argv[2] << " to " << argv[3] << "." << endl;
+            return 1;
+        }
+        cout << "Wrote " << catalog.getProducts().size() << " products to " << argv[3] << endl;
+        return 0;
+    }
+
+    // Inspect the binary order journal
+    if (argc == 3 && string(argv[1]) == "--journal-dump") {
+        return dumpJournal(argv[2]);
+    }
+    if (argc == 4 && string(argv[1]) == "--journal-to-text") {
+        return convertJournalToText(argv[2], argv[3]);
+    }
+
+    // Replay a file of cart and checkout commands without the interactive menu;
+    // orders go to batch-orders.journal unless another data prefix is given
+    if (argc >= 3 && argc <= 5 && string(argv[1]) == "--batch") {
+        int status = runBatch(argv[2], argc >= 4 ? argv[3] : "", argc == 5 ? argv[4] : "batch-");
+        PaymentProcessor::destroyInstance();
+        PaymentProcessor::setDataPrefix("");
+        return status;
+    }
+
+    // Synthetic checkout load: throughput and latency percentiles per pipeline stage
+    if (argc >= 2 && string(argv[1]) == "--bench-checkout") {
+        return benchmarkCheckout(argc - 2, argv + 2);
+    }
+
+    if (argc == 2 && string(argv[1]) == "--bench-totals") {
+        benchmarkLineTotals();
+        return 0;
+    }
+    if (argc == 2 && string(argv[1]) == "--bench-exceptions") {
+        benchmarkExceptions();
+        return 0;
+    }
+    if (argc == 2 && string(argv[1]) == "--bench-payment") {
+        benchmarkPayment();
+        return 0;
+    }
+
     ECommerceSystem system;
     system.run();
 
-    // Save the next order ID before exiting
-    PaymentProcessor::getInstance()->saveNextOrderId();
+    // Save the next order ID and drain the order log before exiting
+    PaymentProcessor::destroyInstance();
 
     return 0;
 }
\ No newline at end of file